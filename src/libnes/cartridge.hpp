@@ -2,42 +2,91 @@
 
 #include <libnes/literals.hpp>
 #include <libnes/ppu_name_table.hpp>
+#include <libnes/ppu_pattern_table.hpp>
+#include <libnes/rom_image.hpp>
+#include <libnes/savestate.hpp>
 
+#include <array>
+#include <cassert>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
 #include <vector>
 
 namespace nes
 {
 
-struct ines_header {
-    [[maybe_unused]] std::array<char, 4> name;
-    std::uint8_t prg_rom_chunks;
-    std::uint8_t chr_rom_chunks;
-    std::uint8_t mapper1;
-    std::uint8_t mapper2;
-    [[maybe_unused]] std::uint8_t prg_ram_size;
-    [[maybe_unused]] std::uint8_t tv_system1;
-    [[maybe_unused]] std::uint8_t tv_system2;
-    [[maybe_unused]] std::array<char, 5> unused;
-};
-
-static_assert(sizeof(ines_header) == 16);
-
-template <std::size_t size>
-using membank = std::array<std::uint8_t, size>;
-
 class cartridge
 {
 public:
+    // PRG ROM as the CPU sees it at $8000-$FFFF, in 1 KB pages
+    static constexpr auto PRG_PAGE_SIZE = 1_Kb;
+    using prg_page_table = std::array<const std::uint8_t*, 32>;
+
+    cartridge() = default;
+    cartridge(const cartridge&) = delete;// the PRG pages point into the derived class
+    auto operator=(const cartridge&) -> cartridge& = delete;
     virtual ~cartridge() = default;
 
-    [[nodiscard]] virtual auto chr0() const noexcept -> const membank<4_Kb>& = 0;
-    [[nodiscard]] virtual auto chr1() const noexcept -> const membank<4_Kb>& = 0;
+    [[nodiscard]] virtual auto chr0() const noexcept -> std::span<const std::uint8_t, 4_Kb> = 0;
+    [[nodiscard]] virtual auto chr1() const noexcept -> std::span<const std::uint8_t, 4_Kb> = 0;
     [[nodiscard]] virtual auto mirroring() const noexcept -> name_table_mirroring = 0;
 
+    // Returns true when a mapper register changed, the PRG pages may have been remapped then
     virtual auto write(std::uint16_t addr, std::uint8_t value) -> bool = 0;
     [[nodiscard]] virtual auto read(std::uint16_t addr) -> std::optional<std::uint8_t> = 0;
+
+    // Mapper registers in saved states, nothing for mappers without any. Loading maps the
+    // PRG pages and CHR banks they select.
+    virtual void save([[maybe_unused]] state_writer& state) const {}
+    virtual void load([[maybe_unused]] state_reader& state) {}
+
+    // Null pages are not mapped, reads from them go through read()
+    [[nodiscard]] auto prg_pages() const noexcept -> const prg_page_table& { return prg_pages_; }
+
+    // CHR bank mapped at $0000 (0) or $1000 (1), decoded on first use after it was switched
+    [[nodiscard]] auto pattern_table(int ix) const noexcept -> const nes::pattern_table& {
+        auto& table = pattern_tables_[ix & 1];
+        if (table == nullptr)
+            table = &decoded_pattern_table(ix & 1);
+        return *table;
+    }
+
+protected:
+    // Points the pages covering [addr, addr + bank size) at the bank
+    void map_prg(std::uint16_t addr, std::span<const std::uint8_t> bank) noexcept {
+        assert(addr >= 0x8000 and addr % PRG_PAGE_SIZE == 0);
+
+        for (auto offset = 0u; offset < bank.size(); offset += PRG_PAGE_SIZE)
+            prg_pages_[(addr - 0x8000 + offset) / PRG_PAGE_SIZE] = bank.data() + offset;
+    }
+
+    [[nodiscard]] auto read_prg(std::uint16_t addr) const noexcept -> std::uint8_t {
+        assert(addr >= 0x8000);
+        return prg_pages_[(addr - 0x8000) / PRG_PAGE_SIZE][addr % PRG_PAGE_SIZE];
+    }
+
+    // To be called by mappers when they switch a CHR bank or CHR RAM gets written
+    void invalidate_pattern_table(int ix) noexcept {
+        pattern_tables_[ix & 1] = nullptr;
+    }
+
+    // The CHR bank mapped at ix decoded. Mappers of a rom_image return the one decoded there,
+    // other cartridges decode it into tables of their own.
+    [[nodiscard]] virtual auto decoded_pattern_table(int ix) const noexcept -> const nes::pattern_table& {
+        if (not decoded_)
+            decoded_ = std::make_unique<std::array<nes::pattern_table, 2>>();
+
+        auto& table = (*decoded_)[ix & 1];
+        table.decode((ix & 1) == 0 ? chr0() : chr1());
+        return table;
+    }
+
+private:
+    mutable std::array<const nes::pattern_table*, 2> pattern_tables_{};
+    mutable std::unique_ptr<std::array<nes::pattern_table, 2>> decoded_;
+    prg_page_table prg_pages_{};
 };
 
 }
\ No newline at end of file
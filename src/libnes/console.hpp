@@ -5,7 +5,17 @@
 #include <libnes/mappers/mmc1.hpp>
 #include <libnes/mappers/nrom.hpp>
 #include <libnes/ppu.hpp>
+#include <libnes/savestate.hpp>
+
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
 
 namespace nes
 {
@@ -18,25 +28,41 @@ concept PPU = requires(T t, std::uint16_t address, std::uint8_t value, nes::cart
     { t.eject_cartridge() };
 };
 
-template <PPU P>
+// cartridge_t is either a concrete, final mapper, so cartridge calls are bound statically,
+// or nes::cartridge itself to dispatch through the virtual functions
+template <PPU P, std::derived_from<cartridge> cartridge_t = cartridge>
 struct console_bus {
     struct controller_hack {
         std::uint8_t keys{0};
         std::uint8_t snapshot{0};
     } j1;
 
-    explicit constexpr console_bus(P& ppu, cartridge* cartridge = nullptr)
+    // Called before every access that depends on the PPU being up to date
+    using sync_callback = std::function<void()>;
+    sync_callback sync;
+
+    explicit constexpr console_bus(P& ppu, cartridge_t* cartridge = nullptr)
         : ppu_{ppu} {
 
+        for (std::size_t page = 0; page < 0x2000 / PAGE_SIZE; ++page) {// 2 KB RAM, mirrored up to $1FFF
+            read_pages_[page] = mem.data() + page * PAGE_SIZE % mem.size();
+            write_pages_[page] = mem.data() + page * PAGE_SIZE % mem.size();
+        }
+
         load_cartridge(cartridge);
     }
 
+    console_bus(const console_bus&) = delete;// the pages point into mem
+    auto operator=(const console_bus&) -> console_bus& = delete;
+
     constexpr auto ppu() -> auto& {
         return ppu_.get();
     }
 
-    constexpr void load_cartridge(cartridge* new_cartridge) {
+    constexpr void load_cartridge(cartridge_t* new_cartridge) {
         cartridge_ = new_cartridge;
+        ++code_generation_;// another cartridge's ROM may be where this one's was
+        map_prg();
 
         ppu().load_cartridge(cartridge_);
     }
@@ -44,40 +70,102 @@ struct console_bus {
     constexpr void eject_cartridge() {
         ppu().eject_cartridge();
         cartridge_ = nullptr;
+        map_prg();
     }
 
-    [[nodiscard]] constexpr auto nmi() {
-        if (not ppu().nmi_raised)
-            return false;
+    // RAM and PRG ROM are accessed through the page tables, everything else goes to
+    // the I/O handlers
+    constexpr void write(std::uint16_t addr, std::uint8_t value) {
+        if (auto page = write_pages_[addr / PAGE_SIZE]) {
+            page[addr % PAGE_SIZE] = value;
+            return;
+        }
 
-        auto nmi_signal = ppu().nmi_raised and not ppu().nmi_seen;
-        ppu().nmi_seen = true;
+        write_io(addr, value);
+    }
 
-        return nmi_signal;
+    constexpr std::uint8_t read(std::uint16_t addr) {
+        if (auto page = read_pages_[addr / PAGE_SIZE])
+            return page[addr % PAGE_SIZE];
+
+        return read_io(addr);
     }
 
-    constexpr void write(std::uint16_t addr, std::uint8_t value) {
-        if (addr < 0x2000) {
-            mem[addr % 0x0800] = value;
+    // PRG ROM the CPU can decode ahead, up to the end of the page
+    [[nodiscard]] constexpr auto code(std::uint16_t addr) const noexcept -> std::span<const std::uint8_t> {
+        if (addr < 0x8000 or read_pages_[addr / PAGE_SIZE] == nullptr)
+            return {};
+
+        return {read_pages_[addr / PAGE_SIZE] + addr % PAGE_SIZE, PAGE_SIZE - addr % PAGE_SIZE};
+    }
+
+    [[nodiscard]] constexpr auto code_generation() const noexcept { return code_generation_; }
+
+    // CPU cycles from now during which reading addr returns what it would now and changes
+    // nothing, 0 when that can't be told. RAM and ROM only change when written to.
+    [[nodiscard]] constexpr auto stable_for(std::uint16_t addr) -> std::int64_t {
+        if (read_pages_[addr / PAGE_SIZE] != nullptr)
+            return std::numeric_limits<std::int64_t>::max();
+
+        if (addr == 0x2002) {
+            sync_ppu();
+            return ppu().dots_status_unchanged() / 3;
+        }
+
+        return 0;
+    }
+
+    [[nodiscard]] constexpr auto cartridge() noexcept { return cartridge_; }
+
+    // RAM, the controller and the mapper registers
+    void save(state_writer& state) const {
+        state.write(mem);
+        state.write(j1.keys);
+        state.write(j1.snapshot);
+
+        if (cartridge_ != nullptr)
+            cartridge_->save(state);
+    }
+
+    void load(state_reader& state) {
+        state.read(mem);
+        state.read(j1.keys);
+        state.read(j1.snapshot);
+
+        if (cartridge_ != nullptr)
+            cartridge_->load(state);
+        map_prg();
+    }
+
+    std::array<std::uint8_t, 2_Kb> mem{};
+
+private:
+    static constexpr auto PAGE_SIZE = cartridge::PRG_PAGE_SIZE;
+    static constexpr auto PAGES = 0x10000 / PAGE_SIZE;
 
-        } else if (addr >= 0x2000 and addr < 0x2008) {
+    constexpr void write_io(std::uint16_t addr, std::uint8_t value) {
+        if (addr >= 0x2000 and addr < 0x2008) {
+            sync_ppu();
             ppu().write(addr, value);
 
         } else if (addr == 0x4014) {
+            sync_ppu();
             ppu().dma_write(value << 8U, [this](auto addr) { return read(addr); });
 
         } else if (addr == 0x4016) {
             j1.snapshot = j1.keys;
+
+        } else if (addr >= 0x8000) {
+            sync_ppu();// mapper registers may switch CHR banks or mirroring
         }
 
-        if (cartridge_ != nullptr)
-            cartridge_->write(addr, value);
+        if (cartridge_ != nullptr and cartridge_->write(addr, value))
+            map_prg();
     }
 
-    constexpr std::uint8_t read(std::uint16_t addr) {
-        if (addr <= 0x1FFF) {
-            return mem[addr & 0x07FF];
-        }
+    constexpr std::uint8_t read_io(std::uint16_t addr) {
+        if (addr < 0x2008)
+            sync_ppu();
 
         if (auto r = ppu().read(addr); r.has_value())
             return r.value();
@@ -98,43 +186,66 @@ struct console_bus {
         return 0;
     }
 
-    [[nodiscard]] constexpr auto cartridge() noexcept { return cartridge_; }
+    // PRG ROM pages are read-only, writes to them are mapper register writes. The code
+    // generation only changes along with a page, not on every mapper register write.
+    constexpr void map_prg() {
+        auto remapped = false;
 
-    std::array<std::uint8_t, 2_Kb> mem{};
+        for (auto page = 0x8000 / PAGE_SIZE; page < PAGES; ++page) {
+            const auto* prg = cartridge_ != nullptr ? cartridge_->prg_pages()[page - 0x8000 / PAGE_SIZE] : nullptr;
+            remapped |= read_pages_[page] != prg;
+            read_pages_[page] = prg;
+        }
 
-private:
-    nes::cartridge* cartridge_{nullptr};
+        if (remapped)
+            ++code_generation_;
+    }
+
+    constexpr void sync_ppu() {
+        if (sync)
+            sync();
+    }
+
+    cartridge_t* cartridge_{nullptr};
     std::reference_wrapper<P> ppu_;
+
+    std::array<const std::uint8_t*, PAGES> read_pages_{};
+    std::array<std::uint8_t*, PAGES> write_pages_{};
+    std::uint32_t code_generation_{0};
 };
 
-class console
+template <std::derived_from<cartridge> cartridge_t = cartridge>
+class basic_console
 {
 public:
-    using bus = console_bus<ppu>;
+    using bus = console_bus<ppu, cartridge_t>;
     using cpu = nes::cpu<bus>;
 
-    explicit console(std::unique_ptr<cartridge> rom)
+    static_assert(code_bus<bus>, "code running from PRG ROM is decoded ahead");
+    static_assert(polled_bus<bus>, "idle loops are skipped");
+
+    explicit basic_console(std::unique_ptr<cartridge_t> rom)
         : cartridge_{std::move(rom)}
         , bus_{ppu_, cartridge_.get()} {
     }
 
+    // The CPU runs ahead of the PPU until the next NMI edge; the PPU catches up in bulk
+    // then, and whenever the CPU touches something that depends on the PPU state
     template <screen screen_t>
     void render_frame(screen_t& screen) {
-        auto count = 0;
-        for (;; ++count) {
-            cpu_.tick();
-
-            ppu_.tick_old(screen);
-            if (ppu_.is_frame_ready()) break;
-            ppu_.tick_old(screen);
-            if (ppu_.is_frame_ready()) break;
-            ppu_.tick_old(screen);
-            if (ppu_.is_frame_ready()) break;
+        bus_.sync = [this, &screen] { sync_ppu(screen); };
+
+        for (auto frame = frame_; frame == frame_;) {
+            auto deadline = master_clock_ + ppu_.dots_to_nmi_edge();
+
+            cpu_.run((deadline - cpu_clock() + 2) / 3);
+            sync_ppu(screen);
         }
-        assert(count == 29780 || count == 29781);
+
+        bus_.sync = nullptr;
     }
 
-    template <screen screen_t>
+    template <rgb_screen screen_t>
     void render_nametables(screen_t& screen) {
         ppu_.render_nametables(screen);
     }
@@ -147,11 +258,187 @@ public:
         bus_.j1.keys = keys;
     }
 
+    void select_cpu_backend(cpu_backend backend) {
+        cpu_.select_backend(backend);
+    }
+
+    // Blocks made by tools/recompile, instantiated for this console's cpu type
+    void load_compiled(std::span<const compiled_block<cpu>> blocks) {
+        cpu_.load_compiled(blocks);
+    }
+
+    // The whole console between frames, in a versioned, little endian format that only
+    // loads into a console with the same cartridge. Saving into a buffer allocates nothing
+    // and returns the size of the state; it didn't fit when that's more than the buffer.
+    auto save_state(std::span<std::uint8_t> buffer) const -> std::size_t {
+        auto state = state_writer{buffer};
+
+        state.write(SAVESTATE_MAGIC);
+        state.write(SAVESTATE_VERSION);
+
+        cpu_.save_state().save(state);
+        bus_.save(state);
+        ppu_.save(state);
+        state.write(master_clock_);
+        state.write(frame_);
+
+        return state.size();
+    }
+
+    [[nodiscard]] auto save_state() const -> std::vector<std::uint8_t> {
+        auto state = std::vector<std::uint8_t>(save_state({}));
+        save_state(state);
+        return state;
+    }
+
+    // Throws bad_savestate for a state of another version, size or with a value out of
+    // range, and the console is then as it was. Out of range values only show up part way
+    // through, so the state loaded over is kept until the whole of it has loaded.
+    void load_state(std::span<const std::uint8_t> saved) {
+        auto state = state_reader{saved};
+
+        if (state.read<std::uint32_t>() != SAVESTATE_MAGIC)
+            throw bad_savestate("not a saved state");
+        if (state.read<std::uint16_t>() != SAVESTATE_VERSION)
+            throw bad_savestate("saved state of another version");
+        if (saved.size() != save_state({}))
+            throw bad_savestate("saved state of another console");
+
+        replaced_state_.resize(saved.size());
+        save_state(replaced_state_);
+        try {
+            load(state);
+        } catch (...) {
+            auto replaced = state_reader{std::span{replaced_state_}.subspan(sizeof(SAVESTATE_MAGIC) + sizeof(SAVESTATE_VERSION))};
+            load(replaced);
+            throw;
+        }
+    }
+
 private:
-    std::unique_ptr<cartridge> cartridge_;
+    // A saved state past its magic and version
+    void load(state_reader& state) {
+        auto cpu_state = nes::cpu_state{};
+        cpu_state.load(state);
+        cpu_.load_state(cpu_state);
+        bus_.load(state);
+        ppu_.load(state);
+        state.read(master_clock_);
+        state.read(frame_);
+    }
+
+    // CPU time in master clock units, three per CPU cycle
+    [[nodiscard]] auto cpu_clock() const { return cpu_.cycles() * 3; }
+
+    template <screen screen_t>
+    void sync_ppu(screen_t& screen) {
+        while (master_clock_ < cpu_clock()) {
+            master_clock_ += ppu_.run(screen, cpu_clock() - master_clock_);
+
+            if (ppu_.nmi_raised and not ppu_.nmi_seen) {
+                ppu_.nmi_seen = true;
+                cpu_.signal_nmi(master_clock_ / 3);
+            }
+
+            if (ppu_.is_frame_ready()) {
+                // the rest of the CPU cycle the frame ends in is not given to the PPU
+                master_clock_ = (master_clock_ + 2) / 3 * 3;
+                ++frame_;
+            }
+        }
+    }
+
+    std::unique_ptr<cartridge_t> cartridge_;
     ppu ppu_{nes::DEFAULT_COLORS};
     bus bus_{ppu_};
     cpu cpu_{bus_};
+
+    std::int64_t master_clock_{0};// PPU time, one unit per dot
+    std::int64_t frame_{0};
+
+    std::vector<std::uint8_t> replaced_state_;// by load_state, kept so it doesn't allocate every time
+};
+
+// Works with any mapper through the cartridge's virtual functions
+using console = basic_console<>;
+
+// A console instantiated for the concrete mapper of the cartridge it was made for, falling
+// back to the virtual dispatch of nes::console for mappers without an instantiation
+class any_console
+{
+public:
+    using variant = std::variant<
+        std::unique_ptr<basic_console<nrom>>,
+        std::unique_ptr<basic_console<mmc1>>,
+        std::unique_ptr<console>>;
+
+    explicit any_console(std::unique_ptr<cartridge> rom)
+        : console_{make(std::move(rom))} {}
+
+    // Calls f with the console instantiation in use
+    decltype(auto) visit(auto&& f) {
+        return std::visit([&f](auto& c) -> decltype(auto) { return f(*c); }, console_);
+    }
+
+    decltype(auto) visit(auto&& f) const {
+        return std::visit([&f](const auto& c) -> decltype(auto) { return f(std::as_const(*c)); }, console_);
+    }
+
+    template <screen screen_t>
+    void render_frame(screen_t& screen) {
+        visit([&screen](auto& c) { c.render_frame(screen); });
+    }
+
+    template <rgb_screen screen_t>
+    void render_nametables(screen_t& screen) {
+        visit([&screen](auto& c) { c.render_nametables(screen); });
+    }
+
+    auto display_pattern_table(auto i) const {
+        return visit([i](const auto& c) { return c.display_pattern_table(i); });
+    }
+
+    void controller_input(std::uint8_t keys) {
+        visit([keys](auto& c) { c.controller_input(keys); });
+    }
+
+    void select_cpu_backend(cpu_backend backend) {
+        visit([backend](auto& c) { c.select_cpu_backend(backend); });
+    }
+
+    auto save_state(std::span<std::uint8_t> buffer) const -> std::size_t {
+        return visit([buffer](const auto& c) { return c.save_state(buffer); });
+    }
+
+    [[nodiscard]] auto save_state() const -> std::vector<std::uint8_t> {
+        return visit([](const auto& c) { return c.save_state(); });
+    }
+
+    void load_state(std::span<const std::uint8_t> state) {
+        visit([state](auto& c) { c.load_state(state); });
+    }
+
+private:
+    template <class mapper_t>
+    static auto downcast(std::unique_ptr<cartridge>& rom) -> std::unique_ptr<mapper_t> {
+        if (auto mapper = dynamic_cast<mapper_t*>(rom.get())) {
+            rom.release();
+            return std::unique_ptr<mapper_t>{mapper};
+        }
+        return nullptr;
+    }
+
+    static auto make(std::unique_ptr<cartridge> rom) -> variant {
+        if (auto mapper = downcast<nrom>(rom))
+            return std::make_unique<basic_console<nrom>>(std::move(mapper));
+
+        if (auto mapper = downcast<mmc1>(rom))
+            return std::make_unique<basic_console<mmc1>>(std::move(mapper));
+
+        return std::make_unique<console>(std::move(rom));
+    }
+
+    variant console_;
 };
 
-}// namespace nes
\ No newline at end of file
+}// namespace nes
@@ -0,0 +1,115 @@
+#include <libnes/console_pool.hpp>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace nes
+{
+
+namespace
+{
+
+void pin_to_core(std::jthread& thread, unsigned core) {
+#if defined(__linux__)
+    auto cores = cpu_set_t{};
+    CPU_ZERO(&cores);
+    CPU_SET(core, &cores);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cores), &cores);// only a hint, failing is fine
+#else
+    (void) thread;
+    (void) core;
+#endif
+}
+
+}// namespace
+
+console_pool::console_pool(unsigned threads)
+    : ranges_(std::max(threads, 1u)) {
+    const auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (auto i = 1u; i < ranges_.size(); ++i) {
+        workers_.emplace_back([this, i](std::stop_token stop) { worker(stop, i); });
+        pin_to_core(workers_.back(), i % cores);
+    }
+}
+
+console_pool::~console_pool() {
+    for (auto& w: workers_)
+        w.request_stop();
+
+    batch_.fetch_add(1, std::memory_order_release);
+    batch_.notify_all();
+}
+
+auto console_pool::add(std::unique_ptr<cartridge> rom) -> std::size_t {
+    instances_.push_back(std::make_unique<instance>(any_console{std::move(rom)}));
+    return instances_.size() - 1;
+}
+
+void console_pool::run_frames(int frames) {
+    frames_ = frames;
+    finished_.store(0, std::memory_order_relaxed);
+
+    for (auto i = std::size_t{0}; i < ranges_.size(); ++i) {
+        ranges_[i].next.store(size() * i / ranges_.size(), std::memory_order_relaxed);
+        ranges_[i].end = size() * (i + 1) / ranges_.size();
+    }
+
+    batch_.fetch_add(1, std::memory_order_release);
+    batch_.notify_all();
+
+    run_batch(0);
+
+    for (auto done = finished_.load(std::memory_order_acquire); done != workers_.size(); done = finished_.load(std::memory_order_acquire))
+        finished_.wait(done, std::memory_order_acquire);
+}
+
+void console_pool::worker(std::stop_token stop, std::size_t self) {
+    // Batches start one at a time, each after every thread has finished the one before
+    for (auto seen = std::uint64_t{0};; ++seen) {
+        batch_.wait(seen, std::memory_order_acquire);
+        if (stop.stop_requested())
+            return;
+
+        run_batch(self);
+
+        finished_.fetch_add(1, std::memory_order_release);
+        finished_.notify_all();
+    }
+}
+
+void console_pool::run_batch(std::size_t self) {
+    for (auto k = std::size_t{0}; k < ranges_.size(); ++k) {
+        auto& range = ranges_[(self + k) % ranges_.size()];
+
+        for (auto i = range.next.fetch_add(1, std::memory_order_relaxed); i < range.end; i = range.next.fetch_add(1, std::memory_order_relaxed))
+            run_instance(*instances_[i]);
+    }
+}
+
+// Whatever the console throws is kept, so every thread gets through the batch
+void console_pool::run_instance(instance& instance) const noexcept {
+    if (frames_ <= 0 or instance.error != nullptr)
+        return;
+
+    try {
+        auto none = null_screen{};
+        instance.console.controller_input(instance.input);
+
+        for (auto i = 1; i < frames_; ++i)
+            instance.console.render_frame(none);
+
+        if (instance.render)
+            instance.console.render_frame(instance.frame);
+        else
+            instance.console.render_frame(none);
+    } catch (...) {
+        instance.error = std::current_exception();
+    }
+}
+
+}// namespace nes
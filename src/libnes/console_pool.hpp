@@ -0,0 +1,83 @@
+#pragma once
+
+#include <libnes/cartridge.hpp>
+#include <libnes/console.hpp>
+#include <libnes/indexed_frame.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace nes
+{
+
+// Many consoles stepped together, a batch of frames at a time, on a pool of threads. Every
+// thread gets a contiguous range of the consoles and steals from the ranges of the others
+// once its own is done, so a thread keeps running the same consoles batch after batch.
+class console_pool
+{
+public:
+    // The calling thread is one of them, the others are pinned to cores where supported
+    explicit console_pool(unsigned threads = std::thread::hardware_concurrency());
+    ~console_pool();
+
+    console_pool(const console_pool&) = delete;
+    console_pool& operator=(const console_pool&) = delete;
+
+    // Returns the index of the new console
+    auto add(std::unique_ptr<cartridge> rom) -> std::size_t;
+
+    [[nodiscard]] auto size() const noexcept { return instances_.size(); }
+    [[nodiscard]] auto threads() const noexcept { return ranges_.size(); }
+
+    // Controller 1 of console i for the next batches
+    void input(std::size_t i, std::uint8_t keys) noexcept { instances_[i]->input = keys; }
+
+    // Whether the last frame of a batch is drawn into frame(i), otherwise no frame is
+    void render(std::size_t i, bool enabled) noexcept { instances_[i]->render = enabled; }
+
+    [[nodiscard]] auto frame(std::size_t i) const noexcept -> const indexed_frame& { return instances_[i]->frame; }
+    [[nodiscard]] auto console(std::size_t i) noexcept -> any_console& { return instances_[i]->console; }
+
+    // What console i threw, e.g. unsupported_opcode for a jammed CPU; it isn't run any more
+    // then. Null while it runs fine.
+    [[nodiscard]] auto failed(std::size_t i) const noexcept -> std::exception_ptr { return instances_[i]->error; }
+
+    // Runs every console for the given number of frames, returns when all of them are done.
+    // A console that throws is stopped and the others go on; see failed().
+    void run_frames(int frames);
+
+private:
+    struct instance {
+        any_console console;
+        std::uint8_t input{0};
+        bool render{true};
+        indexed_frame frame{};
+        std::exception_ptr error;
+    };
+
+    // Consoles [next, end) of one thread left to run in the batch
+    struct alignas(64) range {
+        std::atomic<std::size_t> next{0};
+        std::size_t end{0};
+    };
+
+    void worker(std::stop_token stop, std::size_t self);
+    void run_batch(std::size_t self);
+    void run_instance(instance& instance) const noexcept;
+
+    std::vector<std::unique_ptr<instance>> instances_;
+    std::vector<range> ranges_;
+
+    int frames_{0};
+    std::atomic<std::uint64_t> batch_{0};
+    std::atomic<std::size_t> finished_{0};
+
+    std::vector<std::jthread> workers_;// last, joined before the rest is gone
+};
+
+}// namespace nes
@@ -1,15 +1,27 @@
 #pragma once
 
 #include <libnes/cpu_address_modes.hpp>
+#include <libnes/cpu_block_cache.hpp>
+#include <libnes/cpu_compiled_code.hpp>
+#include <libnes/cpu_jit.hpp>
+#include <libnes/cpu_opcodes.hpp>
 #include <libnes/cpu_operations.hpp>
 #include <libnes/cpu_registers.hpp>
+#include <libnes/savestate.hpp>
 
+#include <algorithm>
+#include <array>
 #include <concepts>
 #include <cstdint>
-#include <functional>
+#include <exception>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <span>
 #include <stdexcept>
-#include <unordered_map>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace nes
@@ -19,9 +31,118 @@ template <class B>
 concept bus = requires(B b, std::uint16_t address, std::uint8_t value) {
     { b.write(address, value) };
     { b.read(address) } -> std::same_as<std::uint8_t>;
-    { b.nmi() } -> std::same_as<bool>;
 };
 
+// A bus that tells where PRG ROM is mapped, so code running from it can be decoded ahead.
+// code() is the ROM from address to the end of its page, empty if address isn't in ROM;
+// the generation changes whenever the mapping does.
+template <class B>
+concept code_bus = bus<B> and requires(const B b, std::uint16_t address) {
+    { b.code(address) } -> std::same_as<std::span<const std::uint8_t>>;
+    { b.code_generation() } -> std::same_as<std::uint32_t>;
+};
+
+// A code bus that can tell for how many cycles from now reading an address returns what it
+// would now, with no effect beyond the first read (0 when it can't tell), so loops that
+// only poll such addresses can be skipped through
+template <class B>
+concept polled_bus = code_bus<B> and requires(B b, std::uint16_t address) {
+    { b.stable_for(address) } -> std::same_as<std::int64_t>;
+};
+
+// How cpu::run() executes code. The interpreter is the reference; blocks runs code from PRG
+// ROM as decoded blocks on a code_bus and is the same as the interpreter everywhere else.
+// compiled runs the blocks loaded with load_compiled() where they match the ROM; where none
+// does, it translates the decoded blocks that run often to machine code on x86-64 hosts and
+// runs decoded blocks otherwise.
+enum class cpu_backend : std::uint8_t {
+    interpreter,
+    blocks,
+    compiled,
+};
+
+// Devices sharing the IRQ line, which stays asserted while any of them holds it
+enum class irq_source : std::uint8_t {
+    mapper = 0x01,
+    apu_frame_counter = 0x02,
+    apu_dmc = 0x04,
+};
+
+class unsupported_opcode: public std::runtime_error
+{
+public:
+    explicit unsupported_opcode(std::uint8_t opcode);
+};
+
+// Everything the CPU needs to carry on where it was, as plain data to be copied with memcpy
+// and written out as is
+struct cpu_state {
+    std::int64_t cycles;
+    std::int64_t nmi_at;
+    std::int64_t irq_at;
+
+    std::uint16_t pc;
+
+    std::uint8_t s;
+    std::uint8_t p;
+
+    std::uint8_t a;
+    std::uint8_t x;
+    std::uint8_t y;
+
+    std::uint8_t irq_sources;
+
+    // The instruction in flight, an opcode or one of the interrupt sequences past it, and
+    // the base and additional cycles it has left. All 0 between instructions, whichever
+    // backend ran the last one.
+    std::uint16_t operation;
+    std::uint8_t cycles_left;
+    std::uint8_t additional_cycles;
+
+    static constexpr std::uint16_t NMI_OPERATION = 0x100;
+    static constexpr std::uint16_t IRQ_OPERATION = 0x101;
+
+    void save(state_writer& state) const;
+    void load(state_reader& state);
+};
+
+static_assert(std::is_trivially_copyable_v<cpu_state> and std::is_standard_layout_v<cpu_state>);
+
+inline void cpu_state::save(state_writer& state) const {
+    state.write(cycles);
+    state.write(nmi_at);
+    state.write(irq_at);
+    state.write(pc);
+    state.write(s);
+    state.write(p);
+    state.write(a);
+    state.write(x);
+    state.write(y);
+    state.write(irq_sources);
+    state.write(operation);
+    state.write(cycles_left);
+    state.write(additional_cycles);
+}
+
+inline void cpu_state::load(state_reader& state) {
+    state.read(cycles);
+    state.read(nmi_at);
+    state.read(irq_at);
+    state.read(pc);
+    state.read(s);
+    state.read(p);
+    state.read(a);
+    state.read(x);
+    state.read(y);
+    state.read(irq_sources);
+    state.read(operation);
+    state.read(cycles_left);
+    state.read(additional_cycles);
+
+    if (operation > IRQ_OPERATION)
+        throw bad_savestate("CPU operation out of range");
+}
+
 template <bus bus_t>
 class cpu
 {
@@ -38,10 +159,18 @@ public:
     arith_register y{p};
 
     struct instruction {
-        instruction(auto operation, auto address_mode, int cycles = 1)
-            : command_{[operation, address_mode](auto& cpu) { return operation(cpu, address_mode(cpu)); }}
+        using command_t = int (*)(cpu&);
+
+        template <class operation_t, class address_mode_t>
+        constexpr instruction(operation_t, address_mode_t, const opcode_info& info)
+            : command_{&command<operation_t, address_mode_t>}
+            , c_{info.cycles}
+            , length_{static_cast<std::uint8_t>(1 + operand_size(info.mode))}
+            , jumps_{is_jump(info.operation)} {}
+        constexpr explicit instruction(command_t command, int cycles = 1)
+            : command_{command}
             , c_{cycles} {}
-        instruction() = default;
+        constexpr instruction() = default;
 
         void execute(cpu& cpu) {
             if (is_finished())
@@ -55,30 +184,68 @@ public:
             }
         }
 
-        [[nodiscard]] bool is_finished() const noexcept { return c_ == 0 && ac_ == 0; }
+        auto complete(cpu& cpu) -> int {
+            auto cycles = c_ + ac_;
+
+            if (c_ != 0) {
+                cpu.cycles_ += c_ - 1;// the command takes effect on the last base cycle
+                ac_ = command_(cpu);
+                cycles += ac_;
+                c_ = 1;
+            }
+
+            cpu.cycles_ += c_ + ac_;
+            c_ = 0;
+            ac_ = 0;
+
+            return cycles;
+        }
+
+        [[nodiscard]] constexpr bool is_finished() const noexcept { return c_ == 0 && ac_ == 0; }
 
     private:
-        std::function<int(cpu&)> command_;
+        friend cpu;
+
+        template <class operation_t, class address_mode_t>
+        static int command(cpu& cpu) {
+            return operation_t{}(cpu, address_mode_t{}(cpu));
+        }
+
+        command_t command_{nullptr};
         int c_{0};
         int ac_{0};
+        std::uint8_t length_{0};// opcode and operands, 0 if it can't be decoded ahead
+        bool jumps_{false};
     };
 
-    struct state {
-        std::uint16_t pc;
+    using state = cpu_state;
 
-        std::uint8_t s;
-        std::uint8_t p;
 
-        std::uint8_t a;
-        std::uint8_t x;
-        std::uint8_t y;
+    void tick();
+    auto step() -> int;
+    auto run(std::int64_t cycle_budget) -> std::int64_t;
+    auto is_executing() { return !current_instruction.is_finished(); }
+    [[nodiscard]] auto cycles() const noexcept { return cycles_; }
 
-        instruction cix;
-    };
+    void select_backend(cpu_backend backend) noexcept { backend_ = backend; }
+    [[nodiscard]] auto backend() const noexcept { return backend_; }
 
+    void load_compiled(std::span<const compiled_block<cpu>> blocks)
+        requires code_bus<bus_t>
+    {
+        compiled_ = compiled_code<cpu>{blocks};
+    }
 
-    void tick();
-    auto is_executing() { return !current_instruction.is_finished(); }
+    // Runs an instruction whose operands were resolved ahead of time, e.g. by recompiled
+    // code, with the program counter already past it
+    void execute(auto operation, auto address_mode, int cycles) {
+        cycles_ += cycles - 1;// the command takes effect on the last base cycle
+        cycles_ += 1 + operation(*this, address_mode(*this));
+    }
+
+    // Whether an interrupt would be taken on the next instruction boundary. A held IRQ
+    // doesn't count while the interrupt disable flag masks it.
+    [[nodiscard]] auto is_interrupt_due() const noexcept { return cycles_ >= serviceable_at(); }
 
     void write(std::uint16_t addr, std::uint8_t value) const { bus_.write(addr, value); }
 
@@ -89,30 +256,117 @@ public:
 
     auto decode(std::uint8_t opcode) -> instruction;
 
-    auto interrupt() -> int;
+    auto interrupt(std::uint16_t vector = 0xFFFA) -> int;
+
+    // Interrupt lines are looked at on the first instruction boundary at or after the given
+    // cycle. NMI is an edge and is taken once, IRQ is taken for as long as it is asserted
+    // and the interrupt disable flag is clear.
+    void signal_nmi(std::int64_t at_cycle) noexcept;
+    void assert_irq(irq_source source, std::int64_t at_cycle) noexcept;
+    void release_irq(irq_source source) noexcept;
 
     [[nodiscard]] auto save_state() const -> state;
-    void load_state(state state);
+    void load_state(const state& state);
 
 
 private:
-    class hasher
-    {
-    public:
-        [[nodiscard]] constexpr auto operator()(std::uint8_t v) const noexcept {
-            return v;
-        }
-    };
+    using instruction_table = std::array<instruction, 256>;
+
+    template <std::uint8_t opcode>
+    static int unsupported(cpu&) { throw unsupported_opcode(opcode); }
+
+    static int take_nmi(cpu& cpu) { return cpu.interrupt(0xFFFA); }
+    static int take_irq(cpu& cpu) { return cpu.interrupt(0xFFFE); }
+
+    static constexpr auto NEVER = std::numeric_limits<std::int64_t>::max();
+
+    // Times a block runs before it is translated to machine code
+    static constexpr std::uint8_t JIT_THRESHOLD = 16;
+
+    void fetch();
+    void schedule_interrupts() noexcept { interrupt_at_ = std::min(nmi_at_, irq_at_); }
+
+    // When the next interrupt that can be taken is due. It follows the interrupt disable
+    // flag, so it's worked out anew wherever P may have changed.
+    [[nodiscard]] auto serviceable_at() const noexcept {
+        return p.test(cpu_flag::int_disable) ? nmi_at_ : interrupt_at_;
+    }
+
+    // Branches, loads, AND, BIT and compares with immediate, zero page or absolute operands.
+    // A loop made of these alone leaves the same state behind every time around, as long as
+    // what it reads doesn't change.
+    static constexpr auto POLLING_OPCODES = std::to_array<std::uint8_t>({
+        0x10, 0x30, 0x50, 0x70, 0x90, 0xB0, 0xD0, 0xF0, 0xA9, 0xA5, 0xAD, 0xA2, 0xA6, 0xAE, 0xA0, 0xA4,
+        0xAC, 0x29, 0x25, 0x2D, 0x24, 0x2C, 0xC9, 0xC5, 0xCD, 0xE0, 0xE4, 0xEC, 0xC0, 0xC4, 0xCC});
+    static constexpr std::uint8_t JMP_ABSOLUTE = 0x4C;
+
+    // The lambdas of the operations and address modes, in the order of mnemonic and addressing
+    using operation_types = std::tuple<
+        decltype(adc), decltype(sbc), decltype(cmp), decltype(cpx), decltype(cpy), decltype(inc), decltype(dec), decltype(inx),
+        decltype(iny), decltype(dex), decltype(dey), decltype(asl), decltype(lsr), decltype(rol), decltype(ror), decltype(ana),
+        decltype(ora), decltype(eor), decltype(bit), decltype(lda), decltype(sta), decltype(ldx), decltype(stx), decltype(ldy),
+        decltype(sty), decltype(tax), decltype(tay), decltype(tsx), decltype(txa), decltype(txs), decltype(tya), decltype(pha),
+        decltype(pla), decltype(php), decltype(plp), decltype(bpl), decltype(bmi), decltype(bvc), decltype(bvs), decltype(bcc),
+        decltype(bcs), decltype(bne), decltype(beq), decltype(clc), decltype(sec), decltype(cld), decltype(sed), decltype(cli),
+        decltype(sei), decltype(clv), decltype(jmp), decltype(jsr), decltype(rts), decltype(rti), decltype(brk), decltype(i_n),
+        decltype(lax), decltype(sax), decltype(isc), decltype(dcp), decltype(slo), decltype(sre), decltype(rla), decltype(rra),
+        decltype(nop)>;
+    using address_mode_types = std::tuple<
+        decltype(imp), decltype(acc), decltype(imm), decltype(zp), decltype(zpx), decltype(zpy), decltype(abs),
+        decltype(abx), decltype(aby), decltype(ind), decltype(izx), decltype(izy), decltype(rel)>;
+
+    static_assert(std::tuple_size_v<operation_types> == static_cast<std::size_t>(mnemonic::nop) + 1);
+    static_assert(std::tuple_size_v<address_mode_types> == static_cast<std::size_t>(addressing::rel) + 1);
+
+    // The instruction of an entry of OPCODES
+    template <std::size_t opcode>
+    static consteval auto make_instruction() -> instruction;
+
+    friend jit_layout;
+
     bus_t& bus_;
     instruction current_instruction;
-    static const std::unordered_map<std::uint8_t, cpu::instruction, hasher> instruction_set;
-};
+    std::uint16_t operation_{0};// what current_instruction is, for the saved state
+    std::int64_t cycles_{0};
 
+    std::int64_t nmi_at_{NEVER};
+    std::int64_t irq_at_{NEVER};
+    std::int64_t interrupt_at_{NEVER};
+    std::uint8_t irq_sources_{0};
 
-class unsupported_opcode: public std::runtime_error
-{
-public:
-    explicit unsupported_opcode(std::uint8_t opcode);
+    cpu_backend backend_{cpu_backend::blocks};
+
+    static const instruction_table instruction_set;
+
+    // An instruction of a decoded block, run to completion in one go
+    struct threaded_operation {
+        typename instruction::command_t command{nullptr};
+        std::uint8_t cycles{0};
+        std::uint8_t length{0};
+    };
+
+    using block = typename block_cache<threaded_operation>::block;
+
+    auto find_block() -> block*;
+    auto run_block(const block& b, std::int64_t cycle_budget) -> std::int64_t;
+
+    auto translate(block& b) -> jit_compiler::entry_point;
+    auto run_native(jit_compiler::entry_point native, std::int64_t cycle_budget) -> std::int64_t;
+
+    [[nodiscard]] static auto is_idle_loop(const block& b, std::uint16_t address) -> bool;
+    auto idle_window(const block& b) -> std::int64_t;
+    auto run_idle_loop(const block& b, std::int64_t cycle_budget) -> std::int64_t;
+
+    struct no_block_cache {};
+    [[no_unique_address]] std::conditional_t<code_bus<bus_t>, block_cache<threaded_operation>, no_block_cache> blocks_;
+
+    auto run_compiled(std::int64_t cycle_budget) -> std::int64_t;
+
+    struct no_compiled_code {};
+    [[no_unique_address]] std::conditional_t<code_bus<bus_t>, compiled_code<cpu>, no_compiled_code> compiled_;
+
+    std::unique_ptr<jit_compiler> jit_;// made on the first translation
+    std::exception_ptr thrown_;// by a command called from machine code, thrown again once it's left
 };
 
 
@@ -124,20 +378,301 @@ cpu<bus_t>::cpu(bus_t& b)
 
 template <bus bus_t>
 void cpu<bus_t>::tick() {
-    if (current_instruction.is_finished()) {
-        if (not bus_.nmi()) {
+    if (current_instruction.is_finished())
+        fetch();
+
+    current_instruction.execute(*this);
+    ++cycles_;
+}
+
+template <bus bus_t>
+auto cpu<bus_t>::step() -> int {
+    if (current_instruction.is_finished())
+        fetch();
 
-            auto opcode = read(pc.advance());
-            current_instruction = decode(opcode);
+    return current_instruction.complete(*this);
+}
 
-        } else {
-            current_instruction = cpu::instruction{
-                [this](auto...) -> int { return interrupt(); },
-                imp};
+template <bus bus_t>
+auto cpu<bus_t>::run(std::int64_t cycle_budget) -> std::int64_t {
+    auto cycles = std::int64_t{0};
+
+    while (cycles < cycle_budget) {
+        if constexpr (code_bus<bus_t>) {
+            if (backend_ != cpu_backend::interpreter and current_instruction.is_finished() and cycles_ < serviceable_at()) {
+                if (backend_ == cpu_backend::compiled and not compiled_.empty()) {
+                    if (auto c = run_compiled(cycle_budget - cycles)) {
+                        cycles += c;
+                        continue;
+                    }
+                }
+
+                if (auto b = find_block()) {
+                    if constexpr (polled_bus<bus_t>) {
+                        if (b->idle) {
+                            cycles += run_idle_loop(*b, cycle_budget - cycles);
+                            continue;
+                        }
+                    }
+
+                    if (backend_ == cpu_backend::compiled) {
+                        if (auto native = translate(*b)) {
+                            cycles += run_native(native, cycle_budget - cycles);
+                            continue;
+                        }
+                    }
+
+                    cycles += run_block(*b, cycle_budget - cycles);
+                    continue;
+                }
+            }
         }
+
+        cycles += step();
     }
 
-    current_instruction.execute(*this);
+    return cycles;
+}
+
+// The cycles the compiled block at pc ran for, 0 if there's none
+template <bus bus_t>
+auto cpu<bus_t>::run_compiled(std::int64_t cycle_budget) -> std::int64_t {
+    const auto code = bus_.code(pc.value());
+    if (code.empty())
+        return 0;
+
+    const auto c = compiled_.find(pc.value(), code);
+    if (c == nullptr)
+        return 0;
+
+    const auto start = cycles_;
+    c->run(*this, start + cycle_budget);
+
+    return cycles_ - start;
+}
+
+template <bus bus_t>
+auto cpu<bus_t>::find_block() -> block* {
+    const auto code = bus_.code(pc.value());
+    if (code.empty())
+        return nullptr;
+
+    const auto generation = bus_.code_generation();
+    auto& b = blocks_.slot(code.data(), generation);
+
+    if (not blocks_.is_current(b, code.data(), generation)) {
+        b.start = code.data();
+        b.generation = generation;
+        b.length = 0;
+        b.runs = 0;
+        b.native = nullptr;
+
+        for (auto offset = std::size_t{0}; b.length < b.operations.size();) {
+            const auto& i = instruction_set[code[offset]];
+            if (i.length_ == 0 or offset + i.length_ > code.size())
+                break;
+
+            b.operations[b.length++] = threaded_operation{i.command_, static_cast<std::uint8_t>(i.c_), i.length_};
+            offset += i.length_;
+
+            // a branch back to the start ends the block too, so loops are blocks of their own
+            const auto loops = (code[offset - i.length_] & 0x1F) == 0x10 and static_cast<std::int8_t>(code[offset - 1]) == -static_cast<int>(offset);
+
+            if (i.jumps_ or loops or offset == code.size())
+                break;
+        }
+
+        if constexpr (polled_bus<bus_t>)
+            b.idle = is_idle_loop(b, pc.value());
+    }
+
+    return b.length != 0 ? &b : nullptr;
+}
+
+// Same as stepping through the block, minus the opcode fetch and decode. The block is
+// left early on a taken branch, on running out of cycles, on an interrupt that can be
+// taken and when the PRG mapping changes under it.
+template <bus bus_t>
+auto cpu<bus_t>::run_block(const block& b, std::int64_t cycle_budget) -> std::int64_t {
+    const auto start = cycles_;
+    auto next = pc.value();
+
+    for (auto i = 0; i < b.length; ++i) {
+        const auto [command, base_cycles, length] = b.operations[i];
+
+        next += length;
+        pc.advance();
+        cycles_ += base_cycles - 1;// the command takes effect on the last base cycle
+        cycles_ += 1 + command(*this);
+
+        if (pc.value() != next or cycles_ - start >= cycle_budget or cycles_ >= serviceable_at() or bus_.code_generation() != b.generation)
+            break;
+    }
+
+    return cycles_ - start;
+}
+
+// The machine code of b, once it has run often enough from where the program counter is
+template <bus bus_t>
+auto cpu<bus_t>::translate(block& b) -> jit_compiler::entry_point {
+    if constexpr (not jit_compiler::available) {
+        return nullptr;
+    } else {
+        if (b.native != nullptr)
+            return b.address == pc.value() ? b.native : nullptr;
+
+        if (++b.runs < JIT_THRESHOLD)
+            return nullptr;
+
+        if (jit_ == nullptr)
+            jit_ = std::make_unique<jit_compiler>(jit_layout::of(*this));
+        if (not jit_->is_usable())
+            return nullptr;
+
+        auto instructions = std::array<jit_instruction, block_cache<threaded_operation>::MAX_LENGTH>{};
+        for (auto offset = 0, i = 0; i < b.length; offset += b.operations[i++].length) {
+            const auto [command, cycles, length] = b.operations[i];
+            instructions[i] = jit_instruction{b.start + offset, reinterpret_cast<std::uintptr_t>(command), cycles, length};
+        }
+
+        const auto code = std::span{instructions}.first(b.length);
+        b.native = jit_->translate(pc.value(), b.generation, code);
+
+        if (b.native == nullptr) {// out of room, start over; or no more machine code at all
+            jit_->clear();
+            blocks_.forget_translations();
+            if (jit_->is_usable())
+                b.native = jit_->translate(pc.value(), b.generation, code);
+        }
+
+        b.address = pc.value();
+        return b.native;
+    }
+}
+
+template <bus bus_t>
+auto cpu<bus_t>::run_native(jit_compiler::entry_point native, std::int64_t cycle_budget) -> std::int64_t {
+    const auto start = cycles_;
+    native(this, start + cycle_budget);
+
+    if (thrown_ != nullptr)
+        std::rethrow_exception(std::exchange(thrown_, nullptr));
+
+    return cycles_ - start;
+}
+
+// Whether the block b, decoded at address, only polls and branches or jumps back to its
+// start. Whichever way it goes through the block, it's the same way every time around.
+template <bus bus_t>
+auto cpu<bus_t>::is_idle_loop(const block& b, std::uint16_t address) -> bool {
+    auto loops = false;
+
+    for (auto offset = 0, i = 0; i < b.length; offset += b.operations[i++].length) {
+        const auto* operation = b.start + offset;
+        const auto next = offset + b.operations[i].length;
+
+        if (operation[0] == JMP_ABSOLUTE)// always the last one
+            return loops or (operation[1] | operation[2] << 8) == address;
+
+        if (std::ranges::find(POLLING_OPCODES, operation[0]) == POLLING_OPCODES.end())
+            return false;
+
+        if ((operation[0] & 0x1F) == 0x10 and static_cast<std::int8_t>(operation[1]) == -next)
+            loops = true;// a branch back to the start
+    }
+
+    return loops;
+}
+
+// CPU cycles from now during which every read of the idle loop b returns what it would now
+template <bus bus_t>
+auto cpu<bus_t>::idle_window(const block& b) -> std::int64_t {
+    auto window = NEVER;
+
+    for (auto offset = 0, i = 0; i < b.length; offset += b.operations[i++].length) {
+        const auto* operation = b.start + offset;
+
+        if (operation[0] == JMP_ABSOLUTE)
+            continue;
+
+        // the address mode is in bits 2-4 of the polling opcodes: 1 is zero page, 3 absolute
+        if (auto mode = (operation[0] >> 2) & 0x07; mode == 1)
+            window = std::min(window, bus_.stable_for(operation[1]));
+        else if (mode == 3)
+            window = std::min(window, bus_.stable_for(static_cast<std::uint16_t>(operation[1] | operation[2] << 8)));
+    }
+
+    return window;
+}
+
+// Runs the idle loop b once, then skips through as many more times around it as end before
+// its reads could change, the budget runs out or an interrupt is due. Each of those would
+// leave the same state behind, only later.
+template <bus bus_t>
+auto cpu<bus_t>::run_idle_loop(const block& b, std::int64_t cycle_budget) -> std::int64_t {
+    const auto start = cycles_;
+    const auto entry = pc.value();
+    const auto window = idle_window(b);
+
+    run_block(b, cycle_budget);
+
+    const auto period = cycles_ - start;
+    if (pc.value() != entry or bus_.code_generation() != b.generation)
+        return period;
+
+    const auto until = std::min({start + cycle_budget, serviceable_at(), window == NEVER ? NEVER : start + window});
+    if (until > cycles_)
+        cycles_ += (until - cycles_) / period * period;
+
+    return cycles_ - start;
+}
+
+template <bus bus_t>
+void cpu<bus_t>::fetch() {
+    if (cycles_ >= interrupt_at_) [[unlikely]] {
+        if (cycles_ >= nmi_at_) {
+            nmi_at_ = NEVER;
+            schedule_interrupts();
+            current_instruction = cpu::instruction{&take_nmi};
+            operation_ = cpu_state::NMI_OPERATION;
+            return;
+        }
+
+        if (not p.test(cpu_flag::int_disable)) {// IRQ is the one due
+            current_instruction = cpu::instruction{&take_irq};
+            operation_ = cpu_state::IRQ_OPERATION;
+            return;
+        }
+    }
+
+    auto opcode = read(pc.advance());
+    current_instruction = decode(opcode);
+    operation_ = opcode;
+}
+
+template <bus bus_t>
+void cpu<bus_t>::signal_nmi(std::int64_t at_cycle) noexcept {
+    nmi_at_ = std::min(nmi_at_, at_cycle);
+    schedule_interrupts();
+}
+
+template <bus bus_t>
+void cpu<bus_t>::assert_irq(irq_source source, std::int64_t at_cycle) noexcept {
+    if (irq_sources_ == 0)
+        irq_at_ = at_cycle;
+
+    irq_sources_ |= static_cast<std::uint8_t>(source);
+    schedule_interrupts();
+}
+
+template <bus bus_t>
+void cpu<bus_t>::release_irq(irq_source source) noexcept {
+    irq_sources_ &= static_cast<std::uint8_t>(~static_cast<std::uint8_t>(source));
+
+    if (irq_sources_ == 0)
+        irq_at_ = NEVER;
+
+    schedule_interrupts();
 }
 
 template <bus bus_t>
@@ -157,20 +692,14 @@ auto cpu<bus_t>::read_word_wrapped(std::uint16_t addr) const -> std::uint16_t {
 
 template <bus bus_t>
 auto cpu<bus_t>::decode(std::uint8_t opcode) -> instruction {
-    auto found = instruction_set.find(opcode);
-    if (found == std::end(instruction_set))
-        return instruction{
-            [opcode](auto...) -> int { throw unsupported_opcode(opcode); },
-            imp};
-
-    return found->second;
+    return instruction_set[opcode];
 }
 
 template <bus bus_t>
-auto cpu<bus_t>::interrupt() -> int {
+auto cpu<bus_t>::interrupt(std::uint16_t vector) -> int {
     write(s.push(), pc.hi());
     write(s.push(), pc.lo());
-    pc.assign(read_word(0xFFFA));
+    pc.assign(read_word(vector));
 
     write(s.push(), p.value());
     p.set(cpu_flag::int_disable);
@@ -180,299 +709,73 @@ auto cpu<bus_t>::interrupt() -> int {
 
 template <bus bus_t>
 auto cpu<bus_t>::save_state() const -> state {
-    return state{
-        pc.value(),
-        s.value(),
-        p.value(),
-        a.value(),
-        x.value(),
-        y.value(),
-        current_instruction};
+    auto state = cpu_state{};// zeroes the padding too
+
+    state.cycles = cycles_;
+    state.nmi_at = nmi_at_;
+    state.irq_at = irq_at_;
+    state.pc = pc.value();
+    state.s = s.value();
+    state.p = p.value();
+    state.a = a.value();
+    state.x = x.value();
+    state.y = y.value();
+    state.irq_sources = irq_sources_;
+    state.operation = current_instruction.is_finished() ? 0 : operation_;// blocks don't keep it
+    state.cycles_left = static_cast<std::uint8_t>(current_instruction.c_);
+    state.additional_cycles = static_cast<std::uint8_t>(current_instruction.ac_);
+
+    return state;
 }
 
 template <bus bus_t>
-void cpu<bus_t>::load_state(state state) {
+void cpu<bus_t>::load_state(const state& state) {
+    cycles_ = state.cycles;
+    nmi_at_ = state.nmi_at;
+    irq_at_ = state.irq_at;
+    irq_sources_ = state.irq_sources;
+    schedule_interrupts();
+
     pc.assign(state.pc);
     s.assign(state.s);
-    p.assign(state.p);
     a.assign(state.a);
     x.assign(state.x);
     y.assign(state.y);
-    current_instruction = state.cix;
+    p.assign(state.p);// last, assigning the others sets N and Z
+
+    operation_ = state.operation;
+    switch (operation_) {
+        case cpu_state::NMI_OPERATION:
+            current_instruction = cpu::instruction{&take_nmi};
+            break;
+        case cpu_state::IRQ_OPERATION:
+            current_instruction = cpu::instruction{&take_irq};
+            break;
+        default:
+            current_instruction = decode(static_cast<std::uint8_t>(operation_));
+            break;
+    }
+    current_instruction.c_ = state.cycles_left;
+    current_instruction.ac_ = state.additional_cycles;
 }
 
 template <bus bus_t>
-const std::unordered_map<std::uint8_t, typename cpu<bus_t>::instruction, typename cpu<bus_t>::hasher> cpu<bus_t>::instruction_set{
-    {0xEA, {nop, imp, 2}},
-
-    {0x1A, {nop, imp, 2}},
-    {0x3A, {nop, imp, 2}},
-    {0x5A, {nop, imp, 2}},
-    {0x7A, {nop, imp, 2}},
-    {0xDA, {nop, imp, 2}},
-    {0xFA, {nop, imp, 2}},
-    {0x82, {nop, imp, 2}},
-
-    {0x04, {i_n, zp, 3} },
-    {0x44, {i_n, zp, 3} },
-    {0x64, {i_n, zp, 3} },
-    {0x0C, {i_n, abs, 4}},
-
-    {0x14, {i_n, zpx, 4}},
-    {0x34, {i_n, zpx, 4}},
-    {0x54, {i_n, zpx, 4}},
-    {0x74, {i_n, zpx, 4}},
-    {0xD4, {i_n, zpx, 4}},
-    {0xF4, {i_n, zpx, 4}},
-
-    {0x1C, {i_n, abx, 4}},
-    {0x3C, {i_n, abx, 4}},
-    {0x5C, {i_n, abx, 4}},
-    {0x7C, {i_n, abx, 4}},
-    {0xDC, {i_n, abx, 4}},
-    {0xFC, {i_n, abx, 4}},
-
-    {0x80, {i_n, imm, 2}},
-    {0x89, {i_n, imm, 2}},
-
-    {0xA7, {lax, zp, 3} },
-    {0xB7, {lax, zpy, 4}},
-    {0xAF, {lax, abs, 4}},
-    {0xBF, {lax, aby, 4}},
-    {0xA3, {lax, izx, 6}},
-    {0xB3, {lax, izy, 5}},
-
-    {0x87, {sax, zp, 3} },
-    {0x97, {sax, zpy, 4}},
-    {0x8F, {sax, abs, 4}},
-    {0x83, {sax, izx, 6}},
-
-    {0xC7, {dcp, zp, 5} },
-    {0xD7, {dcp, zpx, 6}},
-    {0xCF, {dcp, abs, 6}},
-    {0xDF, {dcp, abx, 7}},
-    {0xDB, {dcp, aby, 7}},
-    {0xC3, {dcp, izx, 8}},
-    {0xD3, {dcp, izy, 8}},
-
-    {0xE7, {isc, zp, 5} },
-    {0xF7, {isc, zpx, 6}},
-    {0xEF, {isc, abs, 6}},
-    {0xFF, {isc, abx, 7}},
-    {0xFB, {isc, aby, 7}},
-    {0xE3, {isc, izx, 8}},
-    {0xF3, {isc, izy, 8}},
-
-    {0x07, {slo, zp, 5} },
-    {0x17, {slo, zpx, 6}},
-    {0x0F, {slo, abs, 6}},
-    {0x1F, {slo, abx, 7}},
-    {0x1B, {slo, aby, 7}},
-    {0x03, {slo, izx, 8}},
-    {0x13, {slo, izy, 8}},
-
-    {0x47, {sre, zp, 5} },
-    {0x57, {sre, zpx, 6}},
-    {0x4F, {sre, abs, 6}},
-    {0x5F, {sre, abx, 7}},
-    {0x5B, {sre, aby, 7}},
-    {0x43, {sre, izx, 8}},
-    {0x53, {sre, izy, 8}},
-
-    {0x27, {rla, zp, 5} },
-    {0x37, {rla, zpx, 6}},
-    {0x2F, {rla, abs, 6}},
-    {0x3F, {rla, abx, 7}},
-    {0x3B, {rla, aby, 7}},
-    {0x23, {rla, izx, 8}},
-    {0x33, {rla, izy, 8}},
-
-    {0x67, {rra, zp, 5} },
-    {0x77, {rra, zpx, 6}},
-    {0x6F, {rra, abs, 6}},
-    {0x7F, {rra, abx, 7}},
-    {0x7B, {rra, aby, 7}},
-    {0x63, {rra, izx, 8}},
-    {0x73, {rra, izy, 8}},
-
-    {0xA9, {lda, imm, 2}},
-    {0xA5, {lda, zp, 3} },
-    {0xB5, {lda, zpx, 4}},
-    {0xAD, {lda, abs, 4}},
-    {0xBD, {lda, abx, 4}},
-    {0xB9, {lda, aby, 4}},
-    {0xA1, {lda, izx, 6}},
-    {0xB1, {lda, izy, 5}},
-
-    {0x85, {sta, zp, 3} },
-    {0x95, {sta, zpx, 4}},
-    {0x8D, {sta, abs, 4}},
-    {0x9D, {sta, abx, 5}},
-    {0x99, {sta, aby, 5}},
-    {0x81, {sta, izx, 6}},
-    {0x91, {sta, izy, 6}},
-
-    {0xA2, {ldx, imm, 2}},
-    {0xA6, {ldx, zp, 3} },
-    {0xB6, {ldx, zpy, 4}},
-    {0xAE, {ldx, abs, 4}},
-    {0xBE, {ldx, aby, 4}},
-
-    {0x86, {stx, zp, 3} },
-    {0x96, {stx, zpy, 4}},
-    {0x8E, {stx, abs, 4}},
-
-    {0xA0, {ldy, imm, 2}},
-    {0xA4, {ldy, zp, 3} },
-    {0xB4, {ldy, zpx, 4}},
-    {0xAC, {ldy, abs, 4}},
-    {0xBC, {ldy, abx, 4}},
-
-    {0x84, {sty, zp, 3} },
-    {0x94, {sty, zpx, 4}},
-    {0x8C, {sty, abs, 4}},
-
-    {0xAA, {tax, imp, 2}},
-    {0x8A, {txa, imp, 2}},
-    {0xA8, {tay, imp, 2}},
-    {0x98, {tya, imp, 2}},
-
-    {0xBA, {tsx, imp, 2}},
-    {0x9A, {txs, imp, 2}},
-    {0x48, {pha, imp, 3}},
-    {0x68, {pla, imp, 4}},
-    {0x08, {php, imp, 3}},
-    {0x28, {plp, imp, 4}},
-
-    {0x69, {adc, imm, 2}},
-    {0x65, {adc, zp, 3} },
-    {0x75, {adc, zpx, 4}},
-    {0x6D, {adc, abs, 4}},
-    {0x7D, {adc, abx, 4}},
-    {0x79, {adc, aby, 4}},
-    {0x61, {adc, izx, 6}},
-    {0x71, {adc, izy, 5}},
-
-    {0xE9, {sbc, imm, 2}},
-    {0xEB, {sbc, imm, 2}},
-    {0xE5, {sbc, zp, 3} },
-    {0xF5, {sbc, zpx, 4}},
-    {0xED, {sbc, abs, 4}},
-    {0xFD, {sbc, abx, 4}},
-    {0xF9, {sbc, aby, 4}},
-    {0xE1, {sbc, izx, 6}},
-    {0xF1, {sbc, izy, 5}},
-
-    {0xC9, {cmp, imm, 2}},
-    {0xC5, {cmp, zp, 3} },
-    {0xD5, {cmp, zpx, 4}},
-    {0xCD, {cmp, abs, 4}},
-    {0xDD, {cmp, abx, 4}},
-    {0xD9, {cmp, aby, 4}},
-    {0xC1, {cmp, izx, 6}},
-    {0xD1, {cmp, izy, 5}},
-
-    {0xE0, {cpx, imm, 2}},
-    {0xE4, {cpx, zp, 3} },
-    {0xEC, {cpx, abs, 4}},
-
-    {0xC0, {cpy, imm, 2}},
-    {0xC4, {cpy, zp, 3} },
-    {0xCC, {cpy, abs, 4}},
-
-    {0xE6, {inc, zp, 5} },
-    {0xF6, {inc, zpx, 6}},
-    {0xEE, {inc, abs, 6}},
-    {0xFE, {inc, abx, 7}},
-
-    {0xC6, {dec, zp, 5} },
-    {0xD6, {dec, zpx, 6}},
-    {0xCE, {dec, abs, 6}},
-    {0xDE, {dec, abx, 7}},
-
-    {0xE8, {inx, imp, 2}},
-    {0xC8, {iny, imp, 2}},
-
-    {0xCA, {dex, imp, 2}},
-    {0x88, {dey, imp, 2}},
-
-    {0x0A, {asl, acc, 2}},
-    {0x06, {asl, zp, 5} },
-    {0x16, {asl, zpx, 6}},
-    {0x0E, {asl, abs, 6}},
-    {0x1E, {asl, abx, 7}},
-
-    {0x4A, {lsr, acc, 2}},
-    {0x46, {lsr, zp, 5} },
-    {0x56, {lsr, zpx, 6}},
-    {0x4E, {lsr, abs, 6}},
-    {0x5E, {lsr, abx, 7}},
-
-    {0x2A, {rol, acc, 2}},
-    {0x26, {rol, zp, 5} },
-    {0x36, {rol, zpx, 6}},
-    {0x2E, {rol, abs, 6}},
-    {0x3E, {rol, abx, 7}},
-
-    {0x6A, {ror, acc, 2}},
-    {0x66, {ror, zp, 5} },
-    {0x76, {ror, zpx, 6}},
-    {0x6E, {ror, abs, 6}},
-    {0x7E, {ror, abx, 7}},
-
-    {0x29, {ana, imm, 2}},
-    {0x25, {ana, zp, 3} },
-    {0x35, {ana, zpx, 4}},
-    {0x2D, {ana, abs, 4}},
-    {0x3D, {ana, abx, 4}},
-    {0x39, {ana, aby, 4}},
-    {0x21, {ana, izx, 6}},
-    {0x31, {ana, izy, 5}},
-
-    {0x09, {ora, imm, 2}},
-    {0x05, {ora, zp, 3} },
-    {0x15, {ora, zpx, 4}},
-    {0x0D, {ora, abs, 4}},
-    {0x1D, {ora, abx, 4}},
-    {0x19, {ora, aby, 4}},
-    {0x01, {ora, izx, 6}},
-    {0x11, {ora, izy, 5}},
-
-    {0x49, {eor, imm, 2}},
-    {0x45, {eor, zp, 3} },
-    {0x55, {eor, zpx, 4}},
-    {0x4D, {eor, abs, 4}},
-    {0x5D, {eor, abx, 4}},
-    {0x59, {eor, aby, 4}},
-    {0x41, {eor, izx, 6}},
-    {0x51, {eor, izy, 5}},
-
-    {0x24, {bit, zp, 3} },
-    {0x2C, {bit, abs, 4}},
-
-    {0x10, {bpl, rel, 2}},
-    {0x30, {bmi, rel, 2}},
-    {0x50, {bvc, rel, 2}},
-    {0x70, {bvs, rel, 2}},
-    {0x90, {bcc, rel, 2}},
-    {0xB0, {bcs, rel, 2}},
-    {0xD0, {bne, rel, 2}},
-    {0xF0, {beq, rel, 2}},
-
-    {0x18, {clc, imp, 2}},
-    {0x38, {sec, imp, 2}},
-    {0xD8, {cld, imp, 2}},
-    {0xF8, {sed, imp, 2}},
-    {0x58, {cli, imp, 2}},
-    {0x78, {sei, imp, 2}},
-    {0xB8, {clv, imp, 2}},
-
-    {0x4C, {jmp, abs, 3}},
-    {0x6C, {jmp, ind, 5}},
-    {0x20, {jsr, abs, 6}},
-    {0x60, {rts, imp, 6}},
-    {0x40, {rti, imp, 6}},
-    {0x00, {brk, imp, 7}}
-};
+template <std::size_t opcode>
+consteval auto cpu<bus_t>::make_instruction() -> instruction {
+    constexpr auto info = OPCODES[opcode];
+
+    if constexpr (not info.is_supported())
+        return instruction{&unsupported<opcode>};
+    else
+        return instruction{
+            std::tuple_element_t<static_cast<std::size_t>(info.operation), operation_types>{},
+            std::tuple_element_t<static_cast<std::size_t>(info.mode), address_mode_types>{},
+            info};
+}
+
+template <bus bus_t>
+constexpr typename cpu<bus_t>::instruction_table cpu<bus_t>::instruction_set = []<std::size_t... opcode>(std::index_sequence<opcode...>) {
+    return instruction_table{make_instruction<opcode>()...};
+}(std::make_index_sequence<256>{});
 
 }// namespace nes
\ No newline at end of file
@@ -159,4 +159,80 @@ const auto rel = [](auto& cpu) {
     return memory_based_address_mode{cpu, fetch_addr};
 };
 
-}// namespace nes
\ No newline at end of file
+// Address modes with the operand bytes known ahead of time, for recompiled code
+namespace fixed
+{
+
+struct constant_operand_mode {
+    std::uint16_t address;
+    std::uint8_t value;
+
+    [[nodiscard]] auto load_operand() const { return std::tuple{value, 0}; }
+    [[nodiscard]] auto fetch_address() const { return std::tuple{address, 0}; }
+};
+
+inline auto immediate(std::uint16_t address, std::uint8_t value) {
+    return [=](auto&) { return constant_operand_mode{address, value}; };
+}
+
+inline auto address(std::uint16_t address) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto&) { return std::tuple{address, 0}; }};
+    };
+}
+
+inline auto zero_page_x(std::uint8_t address) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto& cpu) { return std::tuple{(cpu.x.value() + address) % 0x100, 0}; }};
+    };
+}
+
+inline auto zero_page_y(std::uint8_t address) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto& cpu) { return std::tuple{(cpu.y.value() + address) % 0x100, 0}; }};
+    };
+}
+
+inline auto absolute_x(std::uint16_t address) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto& cpu) { return index(address, cpu.x.value()); }};
+    };
+}
+
+inline auto absolute_y(std::uint16_t address) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto& cpu) { return index(address, cpu.y.value()); }};
+    };
+}
+
+inline auto indirect(std::uint16_t address) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto& cpu) { return std::tuple{cpu.read_word_wrapped(address), 0}; }};
+    };
+}
+
+inline auto indirect_x(std::uint8_t address) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto& cpu) {
+            auto indexed = static_cast<std::uint16_t>((address + cpu.x.value()) % 0x100);
+            return std::tuple{cpu.read_word_wrapped(indexed), 0};
+        }};
+    };
+}
+
+inline auto indirect_y(std::uint8_t address) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto& cpu) { return index(cpu.read_word_wrapped(address), cpu.y.value()); }};
+    };
+}
+
+// next is the address of the instruction after the branch
+inline auto relative(std::uint16_t next, std::int8_t offset) {
+    return [=](auto& cpu) {
+        return memory_based_address_mode{cpu, [=](auto&) { return index(next, offset); }};
+    };
+}
+
+}// namespace fixed
+
+}// namespace nes
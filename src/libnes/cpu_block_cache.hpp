@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace nes
+{
+
+// Straight-line runs of decoded instructions, keyed by where their first opcode is in
+// PRG ROM. A block never crosses a bus page and ends after the first instruction that
+// always loads the program counter; branches leave it only when taken. Blocks decoded
+// under a different PRG mapping are rebuilt, along with their machine code.
+//
+// The slots are made on the first lookup, a few at first, so a console that never runs
+// blocks has none. The table doubles, up to MAX_SLOTS, once the blocks that are still
+// current have pushed each other out as many times as it has slots.
+template <class operation_t>
+class block_cache
+{
+public:
+    static constexpr std::size_t MAX_LENGTH = 16;
+    static constexpr std::size_t MIN_SLOTS = 64;
+    static constexpr std::size_t MAX_SLOTS = 2048;
+
+    struct block {
+        const std::uint8_t* start{nullptr};
+        std::uint32_t generation{0};
+        std::uint8_t length{0};
+        bool idle{false};// only polls, then loops back to its start
+        std::array<operation_t, MAX_LENGTH> operations{};
+
+        // Translated by jit_compiler once it has run often enough, for the address it was
+        // at then; the same ROM can be mapped at more than one
+        std::uint8_t runs{0};
+        std::uint16_t address{0};
+        void (*native)(void* cpu, std::int64_t deadline){nullptr};
+    };
+
+    // The slot for the block starting at code; it holds some other block on a miss
+    [[nodiscard]] auto slot(const std::uint8_t* code, std::uint32_t generation) -> block& {
+        if (blocks_.empty())
+            blocks_.resize(MIN_SLOTS);
+
+        if (const auto& b = at(code); b.start != code and b.start != nullptr and b.generation == generation) {
+            if (blocks_.size() < MAX_SLOTS and ++evictions_ == blocks_.size())
+                grow();
+        }
+
+        return at(code);
+    }
+
+    [[nodiscard]] static auto is_current(const block& b, const std::uint8_t* code, std::uint32_t generation) noexcept {
+        return b.start == code and b.generation == generation;
+    }
+
+    // For when the machine code of the blocks is gone
+    void forget_translations() noexcept {
+        for (auto& b: blocks_)
+            b.native = nullptr;
+    }
+
+    [[nodiscard]] auto slots() const noexcept { return blocks_.size(); }
+
+private:
+    [[nodiscard]] auto at(const std::uint8_t* code) noexcept -> block& {
+        return blocks_[reinterpret_cast<std::uintptr_t>(code) % blocks_.size()];
+    }
+
+    // Every block keeps its machine code: the slot of a block in the doubled table is
+    // either where it was or as many slots past that as there were, never taken by another
+    void grow() {
+        auto blocks = std::vector<block>(blocks_.size() * 2);
+        for (auto& b: blocks_) {
+            if (b.start != nullptr)
+                blocks[reinterpret_cast<std::uintptr_t>(b.start) % blocks.size()] = b;
+        }
+
+        blocks_ = std::move(blocks);
+        evictions_ = 0;
+    }
+
+    std::vector<block> blocks_;
+    std::size_t evictions_{0};
+};
+
+}// namespace nes
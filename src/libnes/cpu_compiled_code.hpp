@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace nes
+{
+
+// A basic block translated ahead of time from a ROM by tools/recompile. run executes it
+// from its first instruction and returns early once the deadline is reached or an
+// interrupt is due, with the program counter on the next instruction.
+template <class cpu_t>
+struct compiled_block {
+    std::uint16_t address;
+    std::span<const std::uint8_t> code;
+    void (*run)(cpu_t& cpu, std::int64_t deadline);
+};
+
+// The compiled blocks of a ROM. A block is only used where the bytes it was compiled from
+// are what is mapped at its address, so bank switches and code outside of the ROM it was
+// made for fall back to the other backends.
+template <class cpu_t>
+class compiled_code
+{
+public:
+    using block = compiled_block<cpu_t>;
+
+    compiled_code() = default;
+    explicit compiled_code(std::span<const block> blocks)
+        : blocks_{blocks.begin(), blocks.end()}
+        , found_(0x8000) {
+        std::ranges::sort(blocks_, {}, &block::address);
+    }
+
+    [[nodiscard]] auto empty() const noexcept { return blocks_.empty(); }
+
+    // code is the ROM mapped from address to the end of its page
+    [[nodiscard]] auto find(std::uint16_t address, std::span<const std::uint8_t> code) -> const block* {
+        if (address < 0x8000)
+            return nullptr;
+
+        auto& [key, found] = found_[address - 0x8000];
+
+        if (key != code.data()) {
+            key = code.data();
+            found = nullptr;
+
+            auto [first, last] = std::ranges::equal_range(blocks_, address, {}, &block::address);
+            for (const auto& b: std::ranges::subrange(first, last)) {
+                if (b.code.size() <= code.size() and std::ranges::equal(b.code, code.first(b.code.size()))) {
+                    found = &b;
+                    break;
+                }
+            }
+        }
+
+        return found;
+    }
+
+private:
+    std::vector<block> blocks_;
+
+    // The last lookup at each address from $8000 up, along with where in PRG ROM it was
+    std::vector<std::pair<const std::uint8_t*, const block*>> found_;
+};
+
+}// namespace nes
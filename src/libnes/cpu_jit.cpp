@@ -0,0 +1,644 @@
+#include <libnes/cpu_jit.hpp>
+
+#include <libnes/cpu_opcodes.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if defined(NES_HAS_X86_64_JIT)
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace nes
+{
+
+#if defined(NES_HAS_X86_64_JIT)
+
+namespace
+{
+
+enum reg : std::uint8_t {
+    rax = 0,
+    rcx = 1,
+    rdx = 2,
+    rbx = 3,
+    rsp = 4,
+    rsi = 6,
+    rdi = 7,
+    r12 = 12,
+    r13 = 13,
+    r14 = 14,
+};
+
+enum condition : std::uint8_t {
+    equal = 0x4,
+    not_equal = 0x5,
+    greater_or_equal = 0xD,
+};
+
+#if defined(_WIN32)
+constexpr auto ARGUMENTS = std::pair{rcx, rdx};
+constexpr auto FRAME = 8 + 32;// alignment and the shadow space of the callee
+#else
+constexpr auto ARGUMENTS = std::pair{rdi, rsi};
+constexpr auto FRAME = 8;
+#endif
+
+// The few x86-64 instruction forms translated blocks are made of. Memory operands are all
+// [rbx + disp32], rbx holding the address of the cpu.
+class assembler
+{
+public:
+    [[nodiscard]] auto code() const noexcept -> const std::vector<std::uint8_t>& { return code_; }
+    [[nodiscard]] auto position() const noexcept { return code_.size(); }
+
+    void push(reg r) { rex(false, 0, r), emit(0x50 + (r & 7)); }
+    void pop(reg r) { rex(false, 0, r), emit(0x58 + (r & 7)); }
+    void ret() { emit(0xC3); }
+
+    void mov(reg dst, reg src) { rex(true, src, dst), emit(0x89), direct(src, dst); }
+    void load(reg dst, std::int32_t disp) { rex(true, dst, 0), emit(0x8B), memory(dst, disp); }
+    void store(std::int32_t disp, reg src) { rex(true, src, 0), emit(0x89), memory(src, disp); }
+    void load_nz(reg dst, std::int32_t disp) { rex(true, dst, 0), emit(0x0F, 0x45), memory(dst, disp); }
+    void mov_if_greater(reg dst, reg src) { rex(true, dst, src), emit(0x0F, 0x4F), direct(dst, src); }
+    void compare(reg r, reg with) { rex(true, with, r), emit(0x39), direct(with, r); }
+    void add(reg dst, reg src) { rex(true, src, dst), emit(0x01), direct(src, dst); }
+
+    // lea dst, [dst + src + value]
+    void add(reg dst, reg src, std::int8_t value) {
+        emit(0x48 | (dst & 8) >> 1 | (src & 8) >> 2 | (dst & 8) >> 3, 0x8D);
+        emit(0x44 | (dst & 7) << 3, (src & 7) << 3 | (dst & 7), value);
+    }
+
+    void add(reg r, std::int32_t value) {
+        rex(true, 0, r);
+        if (value >= -128 and value <= 127)
+            emit(0x83), direct(0, r), emit(static_cast<std::uint8_t>(value));
+        else
+            emit(0x81), direct(0, r), imm32(static_cast<std::uint32_t>(value));
+    }
+
+    void mov(reg dst, std::uint64_t value) { rex(true, 0, dst), emit(0xB8 + (dst & 7)), imm64(value); }
+
+    void call(std::uintptr_t function) {
+        emit(0x48, 0xB8), imm64(function);// mov rax, function
+        emit(0xFF, 0xD0);                 // call rax
+    }
+    auto call() -> std::size_t { return emit(0xE8), imm32(0), position(); }
+    void sign_extend_eax() { emit(0x48, 0x98); }
+    void compare_eax(std::uint32_t value) { emit(0x3D), imm32(value); }
+
+    // Byte and word sized
+    void store16(std::int32_t disp, std::uint16_t value) { emit(0x66, 0xC7), memory(0, disp), imm16(value); }
+    void store8(std::int32_t disp, std::uint8_t value) { emit(0xC6), memory(0, disp), emit(value); }
+    void store8(std::int32_t disp, reg src) { emit(0x88), memory(src, disp); }
+    void load8(reg dst, std::int32_t disp) { emit(0x8A), memory(dst, disp); }
+    void load_zero_extended8(reg dst, std::int32_t disp) { emit(0x0F, 0xB6), memory(dst, disp); }
+    void and8(std::int32_t disp, std::uint8_t value) { emit(0x80), memory(4, disp), emit(value); }
+    void or8(std::int32_t disp, std::uint8_t value) { emit(0x80), memory(1, disp), emit(value); }
+    void test8(std::int32_t disp, std::uint8_t value) { emit(0xF6), memory(0, disp), emit(value); }
+    void set_if_above_or_equal8(std::int32_t disp) { emit(0x0F, 0x93), memory(0, disp); }
+
+    // The ALU instruction with the given opcode on al and an immediate
+    void alu_al(std::uint8_t opcode, std::uint8_t value) { emit(opcode, value); }
+    static constexpr std::uint8_t ADD_AL = 0x04;
+    static constexpr std::uint8_t OR_AL = 0x0C;
+    static constexpr std::uint8_t AND_AL = 0x24;
+    static constexpr std::uint8_t SUB_AL = 0x2C;
+    static constexpr std::uint8_t XOR_AL = 0x34;
+
+    // Double word sized, on eax, ecx and edx
+    void mov32(reg dst, reg src) { emit(0x89), direct(src, dst); }
+    void add32(reg dst, reg src) { emit(0x01), direct(src, dst); }
+    void and32(reg dst, reg src) { emit(0x21), direct(src, dst); }
+    void xor32(reg dst, reg src) { emit(0x31), direct(src, dst); }
+    void add_eax(std::uint32_t value) { emit(0x05), imm32(value); }
+    void xor32(reg dst, std::uint32_t value) { emit(0x81), direct(6, dst), imm32(value); }
+    void shift_right32(reg r, std::uint8_t bits) { emit(0xC1), direct(5, r), emit(bits); }
+
+    // Jumps return where their target goes, for bind(); backward ones are known already
+    auto jump() -> std::size_t { return emit(0xE9), imm32(0), position(); }
+    auto jump_if(condition c) -> std::size_t { return emit(0x0F, 0x80 + c), imm32(0), position(); }
+    void jump_to(std::size_t target) { bind(jump(), target); }
+
+    void bind(std::size_t jump, std::size_t target) {
+        const auto offset = static_cast<std::int32_t>(static_cast<std::int64_t>(target) - static_cast<std::int64_t>(jump));
+        std::memcpy(code_.data() + jump - 4, &offset, 4);
+    }
+    void bind(std::size_t jump) { bind(jump, position()); }
+
+private:
+    template <class... bytes_t>
+    void emit(bytes_t... bytes) { (code_.push_back(static_cast<std::uint8_t>(bytes)), ...); }
+
+    void imm16(std::uint16_t value) { emit(value, value >> 8); }
+    void imm32(std::uint32_t value) { emit(value, value >> 8, value >> 16, value >> 24); }
+    void imm64(std::uint64_t value) { imm32(static_cast<std::uint32_t>(value)), imm32(static_cast<std::uint32_t>(value >> 32)); }
+
+    // Only what is needed: 64 bit operands and registers past r7
+    void rex(bool wide, int reg_field, int rm_field) {
+        const auto prefix = 0x40 | (wide ? 0x08 : 0) | (reg_field & 8) >> 1 | (rm_field & 8) >> 3;
+        if (prefix != 0x40)
+            emit(prefix);
+    }
+    void direct(int reg_field, int rm_field) { emit(0xC0 | (reg_field & 7) << 3 | (rm_field & 7)); }
+    void memory(int reg_field, std::int32_t disp) { emit(0x80 | (reg_field & 7) << 3 | rbx), imm32(static_cast<std::uint32_t>(disp)); }
+
+    std::vector<std::uint8_t> code_;
+};
+
+// One block being translated. While it runs, rbx is the cpu, r12 the deadline, r13 the
+// cycle count and r14 the cycle the block has to be left on: the deadline, or the next
+// interrupt that can be taken if that's sooner. The cycle count is written back before
+// every call and read again after it.
+class translation
+{
+public:
+    translation(const jit_layout& layout, std::uint16_t address, std::uint32_t generation)
+        : layout_{layout}
+        , address_{address}
+        , generation_{generation} {}
+
+    auto run(std::span<const jit_instruction> block) -> const std::vector<std::uint8_t>& {
+        prologue();
+
+        auto pc = address_;
+        for (const auto& i: block) {
+            const auto next = static_cast<std::uint16_t>(pc + i.length);
+            const auto info = OPCODES[i.bytes[0]];
+
+            if (info.mode == addressing::rel)
+                branch(i, next);
+            else if (i.bytes[0] == 0x4C)// JMP absolute
+                jump(static_cast<std::uint16_t>(i.bytes[1] | i.bytes[2] << 8), i.cycles);
+            else if (inline_operation(info, i.length > 1 ? i.bytes[1] : 0))
+                a_.add(r13, i.cycles), check_limit(next);
+            else
+                call(i, info, pc);
+
+            if (is_jump(info.operation))
+                return epilogue();
+            pc = next;
+        }
+
+        leave(pc);
+        return epilogue();
+    }
+
+private:
+    void prologue() {
+        a_.push(rbx), a_.push(r12), a_.push(r13), a_.push(r14);
+        a_.add(rsp, -FRAME);
+
+        a_.mov(rbx, ARGUMENTS.first);
+        a_.mov(r12, ARGUMENTS.second);
+        a_.load(r13, layout_.cycles);
+        load_limit();
+
+        top_ = a_.position();
+    }
+
+    // Worked out in a subroutine of its own, it's needed after every call
+    void load_limit() { limit_calls_.push_back(a_.call()); }
+
+    // r14 anew, after anything that may have signalled an interrupt or changed the I flag
+    void limit_subroutine() {
+        for (auto c: limit_calls_)
+            a_.bind(c);
+
+        a_.load(r14, layout_.interrupt_at);
+        a_.test8(layout_.flags, 0x04);
+        a_.load_nz(r14, layout_.nmi_at);
+        a_.compare(r14, r12);
+        a_.mov_if_greater(r14, r12);
+        a_.ret();
+    }
+
+    auto epilogue() -> const std::vector<std::uint8_t>& {
+        const auto exit = a_.position();
+        for (auto j: exits_)
+            a_.bind(j, exit);
+
+        a_.store(layout_.cycles, r13);
+        a_.add(rsp, FRAME);
+        a_.pop(r14), a_.pop(r13), a_.pop(r12), a_.pop(rbx);
+        a_.ret();
+
+        limit_subroutine();
+
+        // out of line, so the straight path through the block stays straight
+        for (auto [j, pc]: limits_) {
+            a_.bind(j);
+            a_.store16(layout_.pc, pc);
+            a_.jump_to(exit);
+        }
+
+        return a_.code();
+    }
+
+    // Leaves with the program counter as it is
+    void leave() { exits_.push_back(a_.jump()); }
+    void leave_if(condition c) { exits_.push_back(a_.jump_if(c)); }
+
+    // Leaves with the program counter on pc
+    void leave(std::uint16_t pc) {
+        a_.store16(layout_.pc, pc);
+        leave();
+    }
+
+    // Leaves with the program counter on pc once the limit is reached
+    void check_limit(std::uint16_t pc) {
+        a_.compare(r13, r14);
+        limits_.emplace_back(a_.jump_if(greater_or_equal), pc);
+    }
+
+    // The target of a taken branch or jump: back to the start without leaving, or out
+    void go_to(std::uint16_t target) {
+        if (target == address_) {
+            check_limit(target);
+            a_.jump_to(top_);
+        } else {
+            leave(target);
+        }
+    }
+
+    void branch(const jit_instruction& i, std::uint16_t next) {
+        const auto target = static_cast<std::uint16_t>(next + static_cast<std::int8_t>(i.bytes[1]));
+        const auto crossed = (next & 0xFF00) != (target & 0xFF00) ? 1 : 0;
+
+        auto not_taken = std::size_t{0};
+        switch (OPCODES[i.bytes[0]].operation) {
+            case mnemonic::bpl:
+                a_.test8(layout_.negative, 0x80), not_taken = a_.jump_if(not_equal);
+                break;
+            case mnemonic::bmi:
+                a_.test8(layout_.negative, 0x80), not_taken = a_.jump_if(equal);
+                break;
+            case mnemonic::bvc:
+                a_.test8(layout_.overflow, 0x80), not_taken = a_.jump_if(not_equal);
+                break;
+            case mnemonic::bvs:
+                a_.test8(layout_.overflow, 0x80), not_taken = a_.jump_if(equal);
+                break;
+            case mnemonic::bcc:
+                a_.test8(layout_.carry, 0xFF), not_taken = a_.jump_if(not_equal);
+                break;
+            case mnemonic::bcs:
+                a_.test8(layout_.carry, 0xFF), not_taken = a_.jump_if(equal);
+                break;
+            case mnemonic::bne:// Z is set when zero_ is 0
+                a_.test8(layout_.zero, 0xFF), not_taken = a_.jump_if(equal);
+                break;
+            default:// beq
+                a_.test8(layout_.zero, 0xFF), not_taken = a_.jump_if(not_equal);
+                break;
+        }
+
+        a_.add(r13, i.cycles + crossed + 1);
+        auto taken_to_next = std::size_t{0};// and so stays in the block
+        if (target == next)
+            taken_to_next = a_.jump();
+        else
+            go_to(target);
+
+        a_.bind(not_taken);
+        a_.add(r13, i.cycles + crossed);
+        if (taken_to_next != 0)
+            a_.bind(taken_to_next);
+
+        check_limit(next);
+    }
+
+    void jump(std::uint16_t target, int cycles) {
+        a_.add(r13, cycles);
+        go_to(target);
+    }
+
+    // Calls the command, as run_block does
+    void call(const jit_instruction& i, const opcode_info& info, std::uint16_t pc) {
+        a_.store16(layout_.pc, static_cast<std::uint16_t>(pc + 1));
+        a_.add(r13, i.cycles - 1);// the command takes effect on the last base cycle
+        a_.store(layout_.cycles, r13);
+
+        a_.mov(ARGUMENTS.first, rbx);
+        a_.mov(ARGUMENTS.second, std::uint64_t{i.command});
+        a_.call(layout_.call_command);
+        a_.load(r13, layout_.cycles);
+        a_.compare_eax(static_cast<std::uint32_t>(jit_layout::THROWN));
+        leave_if(equal);
+        a_.sign_extend_eax();
+        a_.add(r13, rax, 1);
+
+        if (writes_memory(info)) {
+            a_.mov(ARGUMENTS.first, rbx);
+            a_.call(layout_.code_generation);
+            a_.compare_eax(generation_);
+            leave_if(not_equal);
+        }
+
+        if (is_jump(info.operation)) {
+            leave();
+            return;
+        }
+
+        load_limit();
+        a_.compare(r13, r14);
+        leave_if(greater_or_equal);
+    }
+
+    // Z and N of the result in al
+    void set_result() {
+        a_.store8(layout_.zero, rax);
+        a_.store8(layout_.negative, rax);
+    }
+
+    void transfer(std::int32_t from, std::int32_t to) {
+        a_.load8(rax, from);
+        a_.store8(to, rax);
+        set_result();
+    }
+
+    void load_immediate(std::int32_t to, std::uint8_t value) {
+        a_.store8(to, value);
+        a_.store8(layout_.zero, value);
+        a_.store8(layout_.negative, value);
+    }
+
+    void alu(std::int32_t r, std::uint8_t opcode, std::uint8_t value, bool stores = true) {
+        a_.load8(rax, r);
+        a_.alu_al(opcode, value);
+        if (stores)
+            a_.store8(r, rax);
+        set_result();
+    }
+
+    void compare(std::int32_t r, std::uint8_t value) {
+        a_.load8(rax, r);
+        a_.alu_al(assembler::SUB_AL, value);
+        a_.set_if_above_or_equal8(layout_.carry);
+        set_result();
+    }
+
+    // adc_impl: A + operand + C, with V from the signs of the operand, the result and A
+    void add_with_carry(std::uint8_t operand) {
+        a_.load_zero_extended8(rax, layout_.a);
+        a_.mov32(rdx, rax);
+        a_.load_zero_extended8(rcx, layout_.carry);
+        a_.add32(rax, rcx);
+        a_.add_eax(operand);
+        a_.store8(layout_.a, rax);
+        set_result();
+
+        a_.mov32(rcx, rax);
+        a_.xor32(rcx, std::uint32_t{operand});
+        a_.xor32(rdx, rax);
+        a_.and32(rcx, rdx);
+        a_.store8(layout_.overflow, rcx);
+
+        a_.shift_right32(rax, 8);
+        a_.store8(layout_.carry, rax);
+    }
+
+    // Whether the operation was translated to native code, which it is when it doesn't go
+    // to the bus
+    auto inline_operation(const opcode_info& info, std::uint8_t operand) -> bool {
+        const auto immediate = info.mode == addressing::imm;
+        const auto implied = info.mode == addressing::imp;
+
+        switch (info.operation) {
+            case mnemonic::clc:
+                a_.store8(layout_.carry, std::uint8_t{0});
+                return true;
+            case mnemonic::sec:
+                a_.store8(layout_.carry, std::uint8_t{1});
+                return true;
+            case mnemonic::clv:
+                a_.store8(layout_.overflow, std::uint8_t{0});
+                return true;
+            case mnemonic::cld:
+                a_.and8(layout_.flags, static_cast<std::uint8_t>(~0x08));
+                return true;
+            case mnemonic::sed:
+                a_.or8(layout_.flags, 0x08);
+                return true;
+            case mnemonic::cli:
+                a_.and8(layout_.flags, static_cast<std::uint8_t>(~0x04));
+                load_limit();
+                return true;
+            case mnemonic::sei:
+                a_.or8(layout_.flags, 0x04);
+                load_limit();
+                return true;
+
+            case mnemonic::tax:
+                transfer(layout_.a, layout_.x);
+                return true;
+            case mnemonic::tay:
+                transfer(layout_.a, layout_.y);
+                return true;
+            case mnemonic::txa:
+                transfer(layout_.x, layout_.a);
+                return true;
+            case mnemonic::tya:
+                transfer(layout_.y, layout_.a);
+                return true;
+            case mnemonic::tsx:
+                transfer(layout_.s, layout_.x);
+                return true;
+            case mnemonic::txs:
+                a_.load8(rax, layout_.x);
+                a_.store8(layout_.s, rax);
+                return true;
+
+            case mnemonic::inx:
+                alu(layout_.x, assembler::ADD_AL, 1);
+                return true;
+            case mnemonic::iny:
+                alu(layout_.y, assembler::ADD_AL, 1);
+                return true;
+            case mnemonic::dex:
+                alu(layout_.x, assembler::SUB_AL, 1);
+                return true;
+            case mnemonic::dey:
+                alu(layout_.y, assembler::SUB_AL, 1);
+                return true;
+
+            case mnemonic::nop:
+                return implied;
+            case mnemonic::i_n:
+                return implied or immediate;
+
+            default:
+                break;
+        }
+
+        if (not immediate)
+            return false;
+
+        switch (info.operation) {
+            case mnemonic::lda:
+                load_immediate(layout_.a, operand);
+                return true;
+            case mnemonic::ldx:
+                load_immediate(layout_.x, operand);
+                return true;
+            case mnemonic::ldy:
+                load_immediate(layout_.y, operand);
+                return true;
+            case mnemonic::ana:
+                alu(layout_.a, assembler::AND_AL, operand);
+                return true;
+            case mnemonic::ora:
+                alu(layout_.a, assembler::OR_AL, operand);
+                return true;
+            case mnemonic::eor:
+                alu(layout_.a, assembler::XOR_AL, operand);
+                return true;
+            case mnemonic::cmp:
+                compare(layout_.a, operand);
+                return true;
+            case mnemonic::cpx:
+                compare(layout_.x, operand);
+                return true;
+            case mnemonic::cpy:
+                compare(layout_.y, operand);
+                return true;
+            case mnemonic::adc:
+                add_with_carry(operand);
+                return true;
+            case mnemonic::sbc:
+                add_with_carry(static_cast<std::uint8_t>(0xFF - operand));
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    const jit_layout& layout_;
+    std::uint16_t address_;
+    std::uint32_t generation_;
+
+    assembler a_;
+    std::size_t top_{0};
+
+    std::vector<std::size_t> exits_;
+    std::vector<std::size_t> limit_calls_;
+    std::vector<std::pair<std::size_t, std::uint16_t>> limits_;// with the pc to leave on
+};
+
+auto page_size() -> std::size_t {
+#if defined(_WIN32)
+    static const auto size = [] {
+        auto info = SYSTEM_INFO{};
+        GetSystemInfo(&info);
+        return static_cast<std::size_t>(info.dwPageSize);
+    }();
+#else
+    static const auto size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+    return size;
+}
+
+}// namespace
+
+jit_compiler::~jit_compiler() {
+    release();
+}
+
+void jit_compiler::release() noexcept {
+    if (code_ == nullptr)
+        return;
+#if defined(_WIN32)
+    VirtualFree(code_, 0, MEM_RELEASE);
+#else
+    ::munmap(code_, CODE_SIZE);
+#endif
+    code_ = nullptr;
+}
+
+auto jit_compiler::translate(std::uint16_t address, std::uint32_t generation, std::span<const jit_instruction> block) -> entry_point {
+    if (refused_)
+        return nullptr;
+
+    if (code_ == nullptr) {
+#if defined(_WIN32)
+        code_ = static_cast<std::uint8_t*>(VirtualAlloc(nullptr, CODE_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READONLY));
+        if (code_ == nullptr)
+            throw std::bad_alloc();
+#else
+        auto* memory = ::mmap(nullptr, CODE_SIZE, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            throw std::bad_alloc();
+        code_ = static_cast<std::uint8_t*>(memory);
+#endif
+    }
+
+    auto& translated = translated_[key{block.front().bytes, address, generation}];
+    if (translated != nullptr)
+        return translated;
+
+    auto t = translation{layout_, address, generation};
+    const auto& code = t.run(block);
+    if (code.size() > CODE_SIZE - used_) {
+        translated_.erase(key{block.front().bytes, address, generation});
+        return nullptr;
+    }
+
+    // never writable and executable at once. Only the pages the new code goes on change,
+    // each change of protection is a TLB shootdown on every core running the process.
+    auto* entry = code_ + used_;
+    const auto page = page_size();
+    auto* pages = code_ + used_ / page * page;
+    const auto pages_size = (used_ + code.size() + page - 1) / page * page - (pages - code_);
+#if defined(_WIN32)
+    auto previous = DWORD{};
+    auto executable = VirtualProtect(pages, pages_size, PAGE_READWRITE, &previous) != 0;
+    if (executable) {
+        std::ranges::copy(code, entry);
+        executable = VirtualProtect(pages, pages_size, PAGE_EXECUTE_READ, &previous) != 0;
+        FlushInstructionCache(GetCurrentProcess(), entry, code.size());
+    }
+#else
+    auto executable = ::mprotect(pages, pages_size, PROT_READ | PROT_WRITE) == 0;
+    if (executable) {
+        std::ranges::copy(code, entry);
+        executable = ::mprotect(pages, pages_size, PROT_READ | PROT_EXEC) == 0;
+    }
+#endif
+
+    // the host doesn't let code be made executable, e.g. SELinux without execmem
+    if (not executable) {
+        clear();
+        release();
+        refused_ = true;
+        return nullptr;
+    }
+
+    // the next one starts on a cache line of its own
+    used_ += (code.size() + 63) / 64 * 64;
+
+    translated = reinterpret_cast<entry_point>(entry);
+    return translated;
+}
+
+#else
+
+jit_compiler::~jit_compiler() = default;
+
+auto jit_compiler::translate(std::uint16_t, std::uint32_t, std::span<const jit_instruction>) -> entry_point {
+    return nullptr;
+}
+
+#endif
+
+}// namespace nes
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <span>
+#include <unordered_map>
+
+#if defined(__x86_64__) or defined(_M_X64)
+#define NES_HAS_X86_64_JIT
+#endif
+
+namespace nes
+{
+
+// Where translated code finds the CPU state, as offsets from the address of the cpu
+struct jit_layout {
+    std::int32_t pc;
+    std::int32_t cycles;
+    std::int32_t nmi_at;
+    std::int32_t interrupt_at;
+
+    // the parts of flags_register: I, D, B and the unused bit, then C, Z, V and N
+    std::int32_t flags;
+    std::int32_t carry;
+    std::int32_t zero;
+    std::int32_t overflow;
+    std::int32_t negative;
+
+    std::int32_t a;
+    std::int32_t x;
+    std::int32_t y;
+    std::int32_t s;
+
+    // std::uint32_t (*)(cpu&), the code generation of the bus
+    std::uintptr_t code_generation;
+
+    // int (*)(cpu&, command) noexcept, calls a command and returns what it does, or THROWN
+    // with the exception it threw kept in the cpu
+    std::uintptr_t call_command;
+    static constexpr std::int32_t THROWN = std::numeric_limits<std::int32_t>::min();
+
+    template <class cpu_t>
+    static auto of(const cpu_t& cpu) noexcept -> jit_layout;
+};
+
+template <class cpu_t>
+auto jit_layout::of(const cpu_t& cpu) noexcept -> jit_layout {
+    const auto offset = [&cpu](const auto& member) {
+        return static_cast<std::int32_t>(reinterpret_cast<const char*>(&member) - reinterpret_cast<const char*>(&cpu));
+    };
+    const auto code_generation = +[](cpu_t& c) -> std::uint32_t { return c.bus_.code_generation(); };
+    const auto call_command = +[](cpu_t& c, int (*command)(cpu_t&)) noexcept -> int {
+        try {
+            return command(c);
+        } catch (...) {
+            c.thrown_ = std::current_exception();
+            return THROWN;
+        }
+    };
+
+    return {
+        .pc = offset(cpu.pc.val_),
+        .cycles = offset(cpu.cycles_),
+        .nmi_at = offset(cpu.nmi_at_),
+        .interrupt_at = offset(cpu.interrupt_at_),
+        .flags = offset(cpu.p.bits_),
+        .carry = offset(cpu.p.carry_),
+        .zero = offset(cpu.p.zero_),
+        .overflow = offset(cpu.p.overflow_),
+        .negative = offset(cpu.p.negative_),
+        .a = offset(cpu.a.val_),
+        .x = offset(cpu.x.val_),
+        .y = offset(cpu.y.val_),
+        .s = offset(cpu.s.val_),
+        .code_generation = reinterpret_cast<std::uintptr_t>(code_generation),
+        .call_command = reinterpret_cast<std::uintptr_t>(call_command),
+    };
+}
+
+// An instruction of a decoded block. command is the int (*)(cpu&) running it with the
+// program counter past the opcode; it returns the additional cycles taken.
+struct jit_instruction {
+    const std::uint8_t* bytes;
+    std::uintptr_t command;
+    std::uint8_t cycles;
+    std::uint8_t length;
+};
+
+// Translates decoded blocks into x86-64 machine code. Flag and register operations,
+// immediate operands, branches and JMP run natively; everything that goes to the bus calls
+// the command of the instruction, so the bus sees the same accesses at the same cycles as
+// with the interpreter. Translated code has no unwind information, so commands are called
+// through jit_layout::call_command; when one throws, the block is left right after it and
+// the cpu throws the exception again.
+class jit_compiler
+{
+public:
+    // Runs the block from its first instruction until it leaves it, the deadline is reached,
+    // an interrupt is due or the PRG mapping changes, with the program counter on the next
+    // instruction. A taken branch back to the start goes around again without leaving.
+    using entry_point = void (*)(void* cpu, std::int64_t deadline);
+
+#if defined(NES_HAS_X86_64_JIT)
+    static constexpr bool available = true;
+#else
+    static constexpr bool available = false;
+#endif
+
+    explicit jit_compiler(const jit_layout& layout) noexcept
+        : layout_{layout} {}
+    ~jit_compiler();
+
+    jit_compiler(const jit_compiler&) = delete;
+    jit_compiler& operator=(const jit_compiler&) = delete;
+
+    // The block decoded at address under the given code generation, nullptr when there's no
+    // room left for it or no JIT for this host. A block translated before is only looked up,
+    // so blocks evicted from the block cache don't have to be translated again.
+    auto translate(std::uint16_t address, std::uint32_t generation, std::span<const jit_instruction> block) -> entry_point;
+
+    // Whether translating can still work. It stops for good when the host refuses to make
+    // the code executable, and none of the translations so far may be run then either.
+    [[nodiscard]] auto is_usable() const noexcept { return not refused_; }
+
+    // Makes room again; none of the translations so far may be run after this
+    void clear() noexcept {
+        used_ = 0;
+        translated_.clear();
+    }
+
+    // Address space reserved for the machine code on the first translation. Every cpu
+    // running the compiled backend has a compiler of its own, and so a region of its own.
+    static constexpr std::size_t CODE_SIZE = 1024 * 1024;
+
+private:
+    jit_layout layout_;
+
+    void release() noexcept;
+
+    std::uint8_t* code_{nullptr};// mapped on the first translation
+    std::size_t used_{0};
+    bool refused_{false};
+
+    // By where the block is in PRG ROM, its address and its code generation
+    struct key {
+        const std::uint8_t* start;
+        std::uint16_t address;
+        std::uint32_t generation;
+
+        auto operator==(const key&) const -> bool = default;
+    };
+    struct key_hash {
+        auto operator()(const key& k) const noexcept -> std::size_t {
+            return std::hash<const std::uint8_t*>{}(k.start) ^ (std::size_t{k.generation} << 16 | k.address) * 0x9E3779B97F4A7C15u;
+        }
+    };
+    std::unordered_map<key, entry_point, key_hash> translated_;
+};
+
+}// namespace nes
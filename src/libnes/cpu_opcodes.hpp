@@ -0,0 +1,418 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace nes
+{
+
+// The operations of cpu_operations.hpp, one for each of its lambdas
+enum class mnemonic : std::uint8_t {
+    adc, sbc, cmp, cpx, cpy, inc, dec, inx, iny, dex, dey, asl, lsr, rol, ror, ana,
+    ora, eor, bit, lda, sta, ldx, stx, ldy, sty, tax, tay, tsx, txa, txs, tya, pha,
+    pla, php, plp, bpl, bmi, bvc, bvs, bcc, bcs, bne, beq, clc, sec, cld, sed, cli,
+    sei, clv, jmp, jsr, rts, rti, brk, i_n, lax, sax, isc, dcp, slo, sre, rla, rra,
+    nop,
+};
+
+// The address modes of cpu_address_modes.hpp
+enum class addressing : std::uint8_t {
+    imp,
+    acc,
+    imm,
+    zp,
+    zpx,
+    zpy,
+    abs,
+    abx,
+    aby,
+    ind,
+    izx,
+    izy,
+    rel,
+};
+
+// What an opcode does, with which operand and in how many base cycles. Opcodes the CPU
+// doesn't support have no cycles.
+struct opcode_info {
+    mnemonic operation{mnemonic::nop};
+    addressing mode{addressing::imp};
+    std::uint8_t cycles{0};
+
+    [[nodiscard]] constexpr auto is_supported() const noexcept { return cycles != 0; }
+};
+
+// The name of the lambda of the operation
+[[nodiscard]] constexpr auto name(mnemonic m) -> std::string_view {
+    constexpr auto names = std::to_array<std::string_view>({
+        "adc", "sbc", "cmp", "cpx", "cpy", "inc", "dec", "inx", "iny", "dex", "dey", "asl",
+        "lsr", "rol", "ror", "ana", "ora", "eor", "bit", "lda", "sta", "ldx", "stx", "ldy",
+        "sty", "tax", "tay", "tsx", "txa", "txs", "tya", "pha", "pla", "php", "plp", "bpl",
+        "bmi", "bvc", "bvs", "bcc", "bcs", "bne", "beq", "clc", "sec", "cld", "sed", "cli",
+        "sei", "clv", "jmp", "jsr", "rts", "rti", "brk", "i_n", "lax", "sax", "isc", "dcp",
+        "slo", "sre", "rla", "rra", "nop",
+    });
+    return names[static_cast<std::size_t>(m)];
+}
+
+// Bytes following the opcode
+[[nodiscard]] constexpr auto operand_size(addressing mode) noexcept -> int {
+    switch (mode) {
+        case addressing::imp:
+        case addressing::acc:
+            return 0;
+        case addressing::abs:
+        case addressing::abx:
+        case addressing::aby:
+        case addressing::ind:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+// Operations that always load the program counter, unlike the branches
+[[nodiscard]] constexpr auto is_jump(mnemonic m) noexcept {
+    return m == mnemonic::jmp or m == mnemonic::jsr or m == mnemonic::rts or m == mnemonic::rti or m == mnemonic::brk;
+}
+
+// Whether the opcode writes to its operand address, where a mapper may be listening.
+// Pushes only ever write to the stack page.
+[[nodiscard]] constexpr auto writes_memory(const opcode_info& op) noexcept {
+    constexpr auto stores = std::to_array<mnemonic>({
+        mnemonic::sta, mnemonic::stx, mnemonic::sty, mnemonic::sax, mnemonic::asl, mnemonic::lsr, mnemonic::rol, mnemonic::ror,
+        mnemonic::inc, mnemonic::dec, mnemonic::slo, mnemonic::sre, mnemonic::rla, mnemonic::rra, mnemonic::dcp, mnemonic::isc});
+
+    return op.mode != addressing::acc and std::ranges::find(stores, op.operation) != stores.end();
+}
+
+inline namespace details
+{
+
+// Every official opcode has to be in the instruction set, along with this many unofficial
+// ones; the remaining slots are unsupported
+constexpr auto OFFICIAL_OPCODES = std::to_array<std::uint8_t>({
+    0x00, 0x01, 0x05, 0x06, 0x08, 0x09, 0x0A, 0x0D, 0x0E, 0x10, 0x11, 0x15, 0x16, 0x18, 0x19, 0x1D,
+    0x1E, 0x20, 0x21, 0x24, 0x25, 0x26, 0x28, 0x29, 0x2A, 0x2C, 0x2D, 0x2E, 0x30, 0x31, 0x35, 0x36,
+    0x38, 0x39, 0x3D, 0x3E, 0x40, 0x41, 0x45, 0x46, 0x48, 0x49, 0x4A, 0x4C, 0x4D, 0x4E, 0x50, 0x51,
+    0x55, 0x56, 0x58, 0x59, 0x5D, 0x5E, 0x60, 0x61, 0x65, 0x66, 0x68, 0x69, 0x6A, 0x6C, 0x6D, 0x6E,
+    0x70, 0x71, 0x75, 0x76, 0x78, 0x79, 0x7D, 0x7E, 0x81, 0x84, 0x85, 0x86, 0x88, 0x8A, 0x8C, 0x8D,
+    0x8E, 0x90, 0x91, 0x94, 0x95, 0x96, 0x98, 0x99, 0x9A, 0x9D, 0xA0, 0xA1, 0xA2, 0xA4, 0xA5, 0xA6,
+    0xA8, 0xA9, 0xAA, 0xAC, 0xAD, 0xAE, 0xB0, 0xB1, 0xB4, 0xB5, 0xB6, 0xB8, 0xB9, 0xBA, 0xBC, 0xBD,
+    0xBE, 0xC0, 0xC1, 0xC4, 0xC5, 0xC6, 0xC8, 0xC9, 0xCA, 0xCC, 0xCD, 0xCE, 0xD0, 0xD1, 0xD5, 0xD6,
+    0xD8, 0xD9, 0xDD, 0xDE, 0xE0, 0xE1, 0xE4, 0xE5, 0xE6, 0xE8, 0xE9, 0xEA, 0xEC, 0xED, 0xEE, 0xF0,
+    0xF1, 0xF5, 0xF6, 0xF8, 0xF9, 0xFD, 0xFE
+});
+constexpr std::size_t UNOFFICIAL_OPCODE_COUNT = 78;
+
+consteval auto make_opcode_table(std::initializer_list<std::pair<std::uint8_t, opcode_info>> opcodes) {
+    auto table = std::array<opcode_info, 256>{};
+
+    for (const auto& [opcode, info]: opcodes) {
+        if (table[opcode].is_supported())
+            throw std::logic_error("opcode defined twice");
+        if (not info.is_supported())
+            throw std::logic_error("opcode without cycles");
+
+        table[opcode] = info;
+    }
+
+    for (auto opcode: OFFICIAL_OPCODES) {
+        if (not table[opcode].is_supported())
+            throw std::logic_error("official opcode missing");
+    }
+
+    if (std::ranges::count_if(table, &opcode_info::is_supported) != OFFICIAL_OPCODES.size() + UNOFFICIAL_OPCODE_COUNT)
+        throw std::logic_error("unexpected number of unofficial opcodes");
+
+    return table;
+}
+
+}// namespace details
+
+// The instruction set of nes::cpu and of the tools reading 6502 code. Built and checked at
+// compile time, a mistake in the list fails the build.
+inline constexpr auto OPCODES = [] {
+    using enum mnemonic;
+    using enum addressing;
+
+    return make_opcode_table({
+        {0xEA, {nop, imp, 2}},
+
+        {0x1A, {nop, imp, 2}},
+        {0x3A, {nop, imp, 2}},
+        {0x5A, {nop, imp, 2}},
+        {0x7A, {nop, imp, 2}},
+        {0xDA, {nop, imp, 2}},
+        {0xFA, {nop, imp, 2}},
+        {0x82, {nop, imp, 2}},
+
+        {0x04, {i_n, zp, 3} },
+        {0x44, {i_n, zp, 3} },
+        {0x64, {i_n, zp, 3} },
+        {0x0C, {i_n, abs, 4}},
+
+        {0x14, {i_n, zpx, 4}},
+        {0x34, {i_n, zpx, 4}},
+        {0x54, {i_n, zpx, 4}},
+        {0x74, {i_n, zpx, 4}},
+        {0xD4, {i_n, zpx, 4}},
+        {0xF4, {i_n, zpx, 4}},
+
+        {0x1C, {i_n, abx, 4}},
+        {0x3C, {i_n, abx, 4}},
+        {0x5C, {i_n, abx, 4}},
+        {0x7C, {i_n, abx, 4}},
+        {0xDC, {i_n, abx, 4}},
+        {0xFC, {i_n, abx, 4}},
+
+        {0x80, {i_n, imm, 2}},
+        {0x89, {i_n, imm, 2}},
+
+        {0xA7, {lax, zp, 3} },
+        {0xB7, {lax, zpy, 4}},
+        {0xAF, {lax, abs, 4}},
+        {0xBF, {lax, aby, 4}},
+        {0xA3, {lax, izx, 6}},
+        {0xB3, {lax, izy, 5}},
+
+        {0x87, {sax, zp, 3} },
+        {0x97, {sax, zpy, 4}},
+        {0x8F, {sax, abs, 4}},
+        {0x83, {sax, izx, 6}},
+
+        {0xC7, {dcp, zp, 5} },
+        {0xD7, {dcp, zpx, 6}},
+        {0xCF, {dcp, abs, 6}},
+        {0xDF, {dcp, abx, 7}},
+        {0xDB, {dcp, aby, 7}},
+        {0xC3, {dcp, izx, 8}},
+        {0xD3, {dcp, izy, 8}},
+
+        {0xE7, {isc, zp, 5} },
+        {0xF7, {isc, zpx, 6}},
+        {0xEF, {isc, abs, 6}},
+        {0xFF, {isc, abx, 7}},
+        {0xFB, {isc, aby, 7}},
+        {0xE3, {isc, izx, 8}},
+        {0xF3, {isc, izy, 8}},
+
+        {0x07, {slo, zp, 5} },
+        {0x17, {slo, zpx, 6}},
+        {0x0F, {slo, abs, 6}},
+        {0x1F, {slo, abx, 7}},
+        {0x1B, {slo, aby, 7}},
+        {0x03, {slo, izx, 8}},
+        {0x13, {slo, izy, 8}},
+
+        {0x47, {sre, zp, 5} },
+        {0x57, {sre, zpx, 6}},
+        {0x4F, {sre, abs, 6}},
+        {0x5F, {sre, abx, 7}},
+        {0x5B, {sre, aby, 7}},
+        {0x43, {sre, izx, 8}},
+        {0x53, {sre, izy, 8}},
+
+        {0x27, {rla, zp, 5} },
+        {0x37, {rla, zpx, 6}},
+        {0x2F, {rla, abs, 6}},
+        {0x3F, {rla, abx, 7}},
+        {0x3B, {rla, aby, 7}},
+        {0x23, {rla, izx, 8}},
+        {0x33, {rla, izy, 8}},
+
+        {0x67, {rra, zp, 5} },
+        {0x77, {rra, zpx, 6}},
+        {0x6F, {rra, abs, 6}},
+        {0x7F, {rra, abx, 7}},
+        {0x7B, {rra, aby, 7}},
+        {0x63, {rra, izx, 8}},
+        {0x73, {rra, izy, 8}},
+
+        {0xA9, {lda, imm, 2}},
+        {0xA5, {lda, zp, 3} },
+        {0xB5, {lda, zpx, 4}},
+        {0xAD, {lda, abs, 4}},
+        {0xBD, {lda, abx, 4}},
+        {0xB9, {lda, aby, 4}},
+        {0xA1, {lda, izx, 6}},
+        {0xB1, {lda, izy, 5}},
+
+        {0x85, {sta, zp, 3} },
+        {0x95, {sta, zpx, 4}},
+        {0x8D, {sta, abs, 4}},
+        {0x9D, {sta, abx, 5}},
+        {0x99, {sta, aby, 5}},
+        {0x81, {sta, izx, 6}},
+        {0x91, {sta, izy, 6}},
+
+        {0xA2, {ldx, imm, 2}},
+        {0xA6, {ldx, zp, 3} },
+        {0xB6, {ldx, zpy, 4}},
+        {0xAE, {ldx, abs, 4}},
+        {0xBE, {ldx, aby, 4}},
+
+        {0x86, {stx, zp, 3} },
+        {0x96, {stx, zpy, 4}},
+        {0x8E, {stx, abs, 4}},
+
+        {0xA0, {ldy, imm, 2}},
+        {0xA4, {ldy, zp, 3} },
+        {0xB4, {ldy, zpx, 4}},
+        {0xAC, {ldy, abs, 4}},
+        {0xBC, {ldy, abx, 4}},
+
+        {0x84, {sty, zp, 3} },
+        {0x94, {sty, zpx, 4}},
+        {0x8C, {sty, abs, 4}},
+
+        {0xAA, {tax, imp, 2}},
+        {0x8A, {txa, imp, 2}},
+        {0xA8, {tay, imp, 2}},
+        {0x98, {tya, imp, 2}},
+
+        {0xBA, {tsx, imp, 2}},
+        {0x9A, {txs, imp, 2}},
+        {0x48, {pha, imp, 3}},
+        {0x68, {pla, imp, 4}},
+        {0x08, {php, imp, 3}},
+        {0x28, {plp, imp, 4}},
+
+        {0x69, {adc, imm, 2}},
+        {0x65, {adc, zp, 3} },
+        {0x75, {adc, zpx, 4}},
+        {0x6D, {adc, abs, 4}},
+        {0x7D, {adc, abx, 4}},
+        {0x79, {adc, aby, 4}},
+        {0x61, {adc, izx, 6}},
+        {0x71, {adc, izy, 5}},
+
+        {0xE9, {sbc, imm, 2}},
+        {0xEB, {sbc, imm, 2}},
+        {0xE5, {sbc, zp, 3} },
+        {0xF5, {sbc, zpx, 4}},
+        {0xED, {sbc, abs, 4}},
+        {0xFD, {sbc, abx, 4}},
+        {0xF9, {sbc, aby, 4}},
+        {0xE1, {sbc, izx, 6}},
+        {0xF1, {sbc, izy, 5}},
+
+        {0xC9, {cmp, imm, 2}},
+        {0xC5, {cmp, zp, 3} },
+        {0xD5, {cmp, zpx, 4}},
+        {0xCD, {cmp, abs, 4}},
+        {0xDD, {cmp, abx, 4}},
+        {0xD9, {cmp, aby, 4}},
+        {0xC1, {cmp, izx, 6}},
+        {0xD1, {cmp, izy, 5}},
+
+        {0xE0, {cpx, imm, 2}},
+        {0xE4, {cpx, zp, 3} },
+        {0xEC, {cpx, abs, 4}},
+
+        {0xC0, {cpy, imm, 2}},
+        {0xC4, {cpy, zp, 3} },
+        {0xCC, {cpy, abs, 4}},
+
+        {0xE6, {inc, zp, 5} },
+        {0xF6, {inc, zpx, 6}},
+        {0xEE, {inc, abs, 6}},
+        {0xFE, {inc, abx, 7}},
+
+        {0xC6, {dec, zp, 5} },
+        {0xD6, {dec, zpx, 6}},
+        {0xCE, {dec, abs, 6}},
+        {0xDE, {dec, abx, 7}},
+
+        {0xE8, {inx, imp, 2}},
+        {0xC8, {iny, imp, 2}},
+
+        {0xCA, {dex, imp, 2}},
+        {0x88, {dey, imp, 2}},
+
+        {0x0A, {asl, acc, 2}},
+        {0x06, {asl, zp, 5} },
+        {0x16, {asl, zpx, 6}},
+        {0x0E, {asl, abs, 6}},
+        {0x1E, {asl, abx, 7}},
+
+        {0x4A, {lsr, acc, 2}},
+        {0x46, {lsr, zp, 5} },
+        {0x56, {lsr, zpx, 6}},
+        {0x4E, {lsr, abs, 6}},
+        {0x5E, {lsr, abx, 7}},
+
+        {0x2A, {rol, acc, 2}},
+        {0x26, {rol, zp, 5} },
+        {0x36, {rol, zpx, 6}},
+        {0x2E, {rol, abs, 6}},
+        {0x3E, {rol, abx, 7}},
+
+        {0x6A, {ror, acc, 2}},
+        {0x66, {ror, zp, 5} },
+        {0x76, {ror, zpx, 6}},
+        {0x6E, {ror, abs, 6}},
+        {0x7E, {ror, abx, 7}},
+
+        {0x29, {ana, imm, 2}},
+        {0x25, {ana, zp, 3} },
+        {0x35, {ana, zpx, 4}},
+        {0x2D, {ana, abs, 4}},
+        {0x3D, {ana, abx, 4}},
+        {0x39, {ana, aby, 4}},
+        {0x21, {ana, izx, 6}},
+        {0x31, {ana, izy, 5}},
+
+        {0x09, {ora, imm, 2}},
+        {0x05, {ora, zp, 3} },
+        {0x15, {ora, zpx, 4}},
+        {0x0D, {ora, abs, 4}},
+        {0x1D, {ora, abx, 4}},
+        {0x19, {ora, aby, 4}},
+        {0x01, {ora, izx, 6}},
+        {0x11, {ora, izy, 5}},
+
+        {0x49, {eor, imm, 2}},
+        {0x45, {eor, zp, 3} },
+        {0x55, {eor, zpx, 4}},
+        {0x4D, {eor, abs, 4}},
+        {0x5D, {eor, abx, 4}},
+        {0x59, {eor, aby, 4}},
+        {0x41, {eor, izx, 6}},
+        {0x51, {eor, izy, 5}},
+
+        {0x24, {bit, zp, 3} },
+        {0x2C, {bit, abs, 4}},
+
+        {0x10, {bpl, rel, 2}},
+        {0x30, {bmi, rel, 2}},
+        {0x50, {bvc, rel, 2}},
+        {0x70, {bvs, rel, 2}},
+        {0x90, {bcc, rel, 2}},
+        {0xB0, {bcs, rel, 2}},
+        {0xD0, {bne, rel, 2}},
+        {0xF0, {beq, rel, 2}},
+
+        {0x18, {clc, imp, 2}},
+        {0x38, {sec, imp, 2}},
+        {0xD8, {cld, imp, 2}},
+        {0xF8, {sed, imp, 2}},
+        {0x58, {cli, imp, 2}},
+        {0x78, {sei, imp, 2}},
+        {0xB8, {clv, imp, 2}},
+
+        {0x4C, {jmp, abs, 3}},
+        {0x6C, {jmp, ind, 5}},
+        {0x20, {jsr, abs, 6}},
+        {0x60, {rts, imp, 6}},
+        {0x40, {rti, imp, 6}},
+        {0x00, {brk, imp, 7}}
+    });
+}();
+
+}// namespace nes
@@ -2,6 +2,7 @@
 
 #include <libnes/cpu_registers.hpp>
 
+
 namespace nes
 {
 
@@ -41,15 +42,13 @@ inline void adc_impl(auto& result, std::uint8_t accum, std::uint8_t operand, fla
     );
     flags.set(cpu_flag::carry, c);
 
-    auto v = ((operand ^ r) & (r ^ accum) & 0x80u) != 0;
-    flags.set(cpu_flag::overflow, v);
+    flags.set_overflow_bit((operand ^ r) & (r ^ accum));
 
     result = r;
 }
 
 inline void cmp_impl(std::uint8_t accum, std::uint8_t operand, flags_register& flags) {
-    auto alu_result = arith_register{flags};
-    alu_result.assign(accum - operand);
+    flags.set_result(accum - operand);
     flags.set(cpu_flag::carry, accum >= operand);
 }
 
@@ -96,10 +95,10 @@ const auto inc = [](auto& cpu, auto address_mode) {
     auto am = address_mode;
     auto [operand, _] = am.load_operand();
 
-    auto alu_result = arith_register{cpu.p};
-    alu_result.assign(operand + 1);
+    auto result = static_cast<std::uint8_t>(operand + 1);
+    cpu.p.set_result(result);
 
-    am.store_operand(alu_result.value());
+    am.store_operand(result);
     return 0;
 };
 
@@ -107,10 +106,10 @@ const auto dec = [](auto& cpu, auto address_mode) {
     auto am = address_mode;
     auto [operand, _] = am.load_operand();
 
-    auto alu_result = arith_register{cpu.p};
-    alu_result.assign(operand - 1);
+    auto result = static_cast<std::uint8_t>(operand - 1);
+    cpu.p.set_result(result);
 
-    am.store_operand(alu_result.value());
+    am.store_operand(result);
     return 0;
 };
 
@@ -189,8 +188,7 @@ const auto eor = [](auto& cpu, auto address_mode) {
 const auto bit = [](auto& cpu, auto address_mode) {
     auto [operand, additional_cycles] = address_mode.load_operand();
 
-    [[maybe_unused]] auto alu_result = arith_register{cpu.p};
-    alu_result.assign(cpu.a.value() & operand);
+    cpu.p.set_result(cpu.a.value() & operand);
     cpu.p.set(cpu_flag::overflow, operand & (1 << 6));
     cpu.p.set(cpu_flag::negative, operand & (1 << 7));
 
@@ -462,12 +460,12 @@ const auto isc = [](auto& cpu, auto address_mode) {
     auto am = address_mode;
     auto [operand, _] = am.load_operand();
 
-    auto alu_result = arith_register{cpu.p};
-    alu_result.assign(operand + 1);
+    auto result = static_cast<std::uint8_t>(operand + 1);
+    cpu.p.set_result(result);
 
-    am.store_operand(alu_result.value());
+    am.store_operand(result);
 
-    adc_impl(cpu.a, cpu.a.value(), 0xFF - alu_result.value(), cpu.p);
+    adc_impl(cpu.a, cpu.a.value(), 0xFF - result, cpu.p);
     return 0;
 };
 
@@ -475,12 +473,12 @@ const auto dcp = [](auto& cpu, auto address_mode) {
     auto am = address_mode;
     auto [operand, _] = am.load_operand();
 
-    auto alu_result = arith_register{cpu.p};
-    alu_result.assign(operand - 1);
+    auto result = static_cast<std::uint8_t>(operand - 1);
+    cpu.p.set_result(result);
 
-    am.store_operand(alu_result.value());
+    am.store_operand(result);
 
-    cmp_impl(cpu.a.value(), alu_result.value(), cpu.p);
+    cmp_impl(cpu.a.value(), result, cpu.p);
     return 0;
 };
 
@@ -544,4 +542,4 @@ const auto rra = [](auto& cpu, auto address_mode) {
 
 const auto nop = [](auto&, auto) { return 0; };
 
-}// namespace nes
\ No newline at end of file
+}// namespace nes
@@ -1,12 +1,13 @@
 #pragma once
 
-#include <bitset>
 #include <cstdint>
 #include <iostream>
 
 namespace nes
 {
 
+struct jit_layout;
+
 enum class cpu_flag {
     carry = 0,
     zero = 1,
@@ -18,20 +19,78 @@ enum class cpu_flag {
     negative = 7
 };
 
+// N, Z, C and V are kept in the form the ALU leaves them in and are only worked out when
+// tested or pushed, most of them are overwritten before anything looks at them
 class flags_register
 {
-    constexpr static auto pos(cpu_flag f) { return static_cast<size_t>(f); }
+    constexpr static auto mask(cpu_flag f) { return static_cast<std::uint8_t>(1u << static_cast<unsigned>(f)); }
 
 public:
-    void assign(std::uint8_t bits) { bits_ = bits | 0x20u; }
-    void set(cpu_flag f, bool value = true) { bits_.set(pos(f), value); }
-    void reset(cpu_flag f) { bits_.reset(pos(f)); }
+    void assign(std::uint8_t bits) {
+        bits_ = (bits | 0x20u) & 0x3Cu;
+        carry_ = bits & 0x01u;
+        zero_ = ~bits & 0x02u;
+        overflow_ = bits << 1;
+        negative_ = bits;
+    }
+
+    void set(cpu_flag f, bool value = true) {
+        switch (f) {
+            case cpu_flag::carry:
+                carry_ = value;
+                break;
+            case cpu_flag::zero:
+                zero_ = not value;
+                break;
+            case cpu_flag::overflow:
+                overflow_ = value ? 0x80 : 0x00;
+                break;
+            case cpu_flag::negative:
+                negative_ = value ? 0x80 : 0x00;
+                break;
+            default:
+                bits_ = value ? bits_ | mask(f) : bits_ & ~mask(f);
+                break;
+        }
+    }
+    void reset(cpu_flag f) { set(f, false); }
 
-    [[nodiscard]] auto test(cpu_flag f) const { return bits_.test(pos(f)); }
-    [[nodiscard]] auto value() const { return static_cast<std::uint8_t>(bits_.to_ulong()); }
+    // Z and N of an ALU result
+    void set_result(std::uint8_t result) {
+        zero_ = result;
+        negative_ = result;
+    }
+
+    // V is bit 7 of the given byte
+    void set_overflow_bit(std::uint8_t bits) { overflow_ = bits; }
+
+    [[nodiscard]] auto test(cpu_flag f) const -> bool {
+        switch (f) {
+            case cpu_flag::carry:
+                return carry_ != 0;
+            case cpu_flag::zero:
+                return zero_ == 0;
+            case cpu_flag::overflow:
+                return (overflow_ & 0x80u) != 0;
+            case cpu_flag::negative:
+                return (negative_ & 0x80u) != 0;
+            default:
+                return (bits_ & mask(f)) != 0;
+        }
+    }
+
+    [[nodiscard]] auto value() const {
+        return static_cast<std::uint8_t>(bits_ | carry_ | (zero_ == 0 ? 0x02u : 0x00u) | ((overflow_ & 0x80u) >> 1) | (negative_ & 0x80u));
+    }
 
 private:
-    std::bitset<8> bits_{0x20};
+    friend jit_layout;
+
+    std::uint8_t bits_{0x20};// I, D, B and the unused bit, in place
+    std::uint8_t carry_{0};  // 0 or 1
+    std::uint8_t zero_{1};   // Z is set when this is 0
+    std::uint8_t overflow_{0};
+    std::uint8_t negative_{0};
 };
 
 class arith_register
@@ -49,11 +108,12 @@ public:
 
     void assign(std::uint8_t new_val) {
         val_ = new_val;
-        flags_.set(cpu_flag::zero, val_ == 0);
-        flags_.set(cpu_flag::negative, (val_ & 0x80u) != 0);
+        flags_.set_result(val_);
     }
 
 private:
+    friend jit_layout;
+
     std::uint8_t val_{0};
     flags_register& flags_;
 };
@@ -82,6 +142,8 @@ public:
     [[nodiscard]] auto value() const { return val_; }
 
 private:
+    friend jit_layout;
+
     std::uint16_t val_{0};
 };
 
@@ -100,6 +162,8 @@ public:
     [[nodiscard]] auto value() const { return val_; }
 
 private:
+    friend jit_layout;
+
     std::uint8_t val_;
     std::uint16_t stack_base_;
 };
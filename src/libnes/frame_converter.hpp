@@ -0,0 +1,113 @@
+#pragma once
+
+#include <libnes/color.hpp>
+#include <libnes/indexed_frame.hpp>
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <span>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace nes
+{
+
+// Converts palette-indexed frames into packed pixel formats through a 64-entry table per
+// emphasis setting. Grayscale tables are small enough to stay in vector registers, so that
+// format is looked up 16 pixels at a time; for the wider formats a shuffle per output byte
+// costs more than the plain table lookup.
+class frame_converter
+{
+public:
+    explicit frame_converter(const std::array<color, 64>& system_colors) noexcept {
+        for (auto emphasis = 0; emphasis < 8; ++emphasis) {
+            for (auto index = 0; index < 64; ++index) {
+                auto [r, g, b] = emphasized(system_colors[index], emphasis);
+
+                argb8888_[emphasis][index] = 0xFF000000 | (r << 16) | (g << 8) | b;
+                rgb565_[emphasis][index] = static_cast<std::uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+                grayscale_[emphasis][index] = static_cast<std::uint8_t>((r * 77 + g * 150 + b * 29) >> 8);
+            }
+        }
+    }
+
+    void to_argb8888(const indexed_frame& frame, std::span<std::uint32_t> output) const noexcept {
+        convert(frame, argb8888_, output);
+    }
+
+    void to_rgb565(const indexed_frame& frame, std::span<std::uint16_t> output) const noexcept {
+        convert(frame, rgb565_, output);
+    }
+
+    void to_grayscale(const indexed_frame& frame, std::span<std::uint8_t> output) const noexcept {
+        convert(frame, grayscale_, output);
+    }
+
+private:
+    template <class pixel_t>
+    using lookup_table = std::array<std::array<pixel_t, 64>, 8>;
+
+    // Emphasis bits 0-2 are red, green and blue, the other channels are dimmed
+    static auto emphasized(color c, int emphasis) noexcept -> std::array<std::uint32_t, 3> {
+        auto channels = std::array<std::uint32_t, 3>{c.value() >> 16 & 0xFF, c.value() >> 8 & 0xFF, c.value() & 0xFF};
+
+        if (emphasis != 0) {
+            for (auto i = 0; i < 3; ++i) {
+                if ((emphasis & (1 << i)) == 0)
+                    channels[i] = channels[i] * 3 / 4;
+            }
+        }
+        return channels;
+    }
+
+    template <class pixel_t>
+    static void convert(const indexed_frame& frame, const lookup_table<pixel_t>& table, std::span<pixel_t> output) noexcept {
+        assert(output.size() >= indexed_frame::WIDTH * indexed_frame::HEIGHT);
+
+        for (short y = 0; y < indexed_frame::HEIGHT; ++y) {
+            const auto& colors = table[frame.emphasis(y)];
+            const auto row = frame.row(y);
+            auto out = output.data() + y * indexed_frame::WIDTH;
+
+#if defined(__SSSE3__)
+            if constexpr (sizeof(pixel_t) == 1) {
+                convert_ssse3(row, colors, out);
+                continue;
+            }
+#endif
+            for (auto x = 0; x < indexed_frame::WIDTH; ++x)
+                out[x] = colors[row[x]];
+        }
+    }
+
+#if defined(__SSSE3__)
+    // The 64 entries are four 16-byte shuffles; an index outside of a quarter saturates to
+    // a shuffle control with the top bit set, which selects zero
+    static void convert_ssse3(std::span<const std::uint8_t, indexed_frame::WIDTH> row, const std::array<std::uint8_t, 64>& colors, std::uint8_t* out) noexcept {
+        __m128i quarters[4];
+        for (auto q = 0; q < 4; ++q)
+            quarters[q] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors.data() + q * 16));
+
+        for (auto x = 0; x < indexed_frame::WIDTH; x += 16) {
+            const auto indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row.data() + x));
+            auto result = _mm_setzero_si128();
+
+            for (auto q = 0; q < 4; ++q) {
+                const auto offset = _mm_sub_epi8(indices, _mm_set1_epi8(static_cast<char>(q * 16)));
+                const auto control = _mm_adds_epu8(offset, _mm_set1_epi8(0x70));
+                result = _mm_or_si128(result, _mm_shuffle_epi8(quarters[q], control));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), result);
+        }
+    }
+#endif
+
+    lookup_table<std::uint32_t> argb8888_;
+    lookup_table<std::uint16_t> rgb565_;
+    lookup_table<std::uint8_t> grayscale_;
+};
+
+}// namespace nes
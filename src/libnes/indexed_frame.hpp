@@ -0,0 +1,54 @@
+#pragma once
+
+#include <libnes/screen.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace nes
+{
+
+// A frame of system palette indices, one byte per pixel, with the color emphasis bits
+// (PPUMASK bits 5-7) of every line
+class indexed_frame
+{
+public:
+    static constexpr short WIDTH = 256;
+    static constexpr short HEIGHT = 240;
+
+    [[nodiscard]] constexpr static auto width() -> short { return WIDTH; }
+    [[nodiscard]] constexpr static auto height() -> short { return HEIGHT; }
+
+    constexpr void draw_index(point where, std::uint8_t index) noexcept {
+        pixels_[where.y * WIDTH + where.x] = index & 0x3F;
+    }
+
+    constexpr void draw_span(point where, std::span<const std::uint8_t> indices) noexcept {
+        auto out = pixels_.begin() + where.y * WIDTH + where.x;
+        for (auto index: indices)
+            *out++ = index & 0x3F;
+    }
+
+    constexpr void emphasize(short y, std::uint8_t emphasis) noexcept {
+        emphasis_[y] = emphasis & 0x07;
+    }
+
+    [[nodiscard]] constexpr auto index(point where) const noexcept { return pixels_[where.y * WIDTH + where.x]; }
+
+    [[nodiscard]] constexpr auto row(short y) const noexcept -> std::span<const std::uint8_t, WIDTH> {
+        return std::span<const std::uint8_t, WIDTH>{pixels_.data() + y * WIDTH, WIDTH};
+    }
+
+    [[nodiscard]] constexpr auto emphasis(short y) const noexcept { return emphasis_[y]; }
+
+    [[nodiscard]] constexpr auto pixels() const noexcept -> std::span<const std::uint8_t> { return pixels_; }
+
+private:
+    std::array<std::uint8_t, WIDTH * HEIGHT> pixels_{};
+    std::array<std::uint8_t, HEIGHT> emphasis_{};
+};
+
+static_assert(indexed_screen<indexed_frame>);
+
+}// namespace nes
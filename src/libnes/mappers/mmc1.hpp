@@ -5,6 +5,7 @@
 
 #include <array>
 #include <cassert>
+#include <memory>
 #include <optional>
 #include <utility>
 #include <vector>
@@ -48,6 +49,24 @@ public:
         return result;
     }
 
+    void save(state_writer& state) const {
+        state.write(reset_);
+        state.write(value_);
+        state.write(static_cast<std::uint8_t>(count_));
+    }
+
+    void load(state_reader& state) {
+        auto reset = state.read<bool>();
+        auto value = state.read<std::uint8_t>();
+        auto count = state.read<std::uint8_t>();
+        if (count >= 5)
+            throw bad_savestate("MMC1 shift register count out of range");
+
+        reset_ = reset;
+        value_ = value;
+        count_ = count;
+    }
+
 private:
     bool reset_{false};
     std::uint8_t value_{0};
@@ -57,16 +76,23 @@ private:
 class mmc1 final: public cartridge
 {
 public:
-    mmc1(std::vector<std::array<std::uint8_t, 16_Kb>> prg, std::vector<membank<4_Kb>> chr)
-        : prg_{std::move(prg)}
-        , chr_{std::move(chr)} {}
+    explicit mmc1(std::shared_ptr<const rom_image> rom)
+        : rom_{std::move(rom)} {
+        if (rom_->chr_banks() == 0)
+            throw std::invalid_argument("MMC1 without CHR ROM");
 
-    [[nodiscard]] auto chr0() const noexcept -> const membank<4_Kb>& override {
-        return chr_[chr_ix0_ % chr_.size()];
+        map_prg_banks();
     }
 
-    [[nodiscard]] auto chr1() const noexcept -> const membank<4_Kb>& override {
-        return chr_[chr_ix1_ % chr_.size()];
+    mmc1(const std::vector<std::array<std::uint8_t, 16_Kb>>& prg, const std::vector<membank<4_Kb>>& chr)
+        : mmc1{std::make_shared<const rom_image>(prg, chr)} {}
+
+    [[nodiscard]] auto chr0() const noexcept -> std::span<const std::uint8_t, 4_Kb> override {
+        return rom_->chr_bank(chr_ix0_ % rom_->chr_banks());
+    }
+
+    [[nodiscard]] auto chr1() const noexcept -> std::span<const std::uint8_t, 4_Kb> override {
+        return rom_->chr_bank(chr_ix1_ % rom_->chr_banks());
     }
 
     [[nodiscard]] auto mirroring() const noexcept -> name_table_mirroring override {
@@ -82,12 +108,16 @@ public:
             if (addr < 0xA000) {
                 control_ = r.value();
                 set_mirroring();
+                map_prg_banks();
             } else if (addr < 0xC000) {
                 chr_ix0_ = r.value();
+                invalidate_pattern_table(0);
             } else if (addr < 0xE000) {
                 chr_ix1_ = r.value();
+                invalidate_pattern_table(1);
             } else {
                 prg_ix_ = r.value();
+                map_prg_banks();
             }
 
             return true;
@@ -97,38 +127,31 @@ public:
     }
 
     [[nodiscard]] auto read(std::uint16_t addr) -> std::optional<std::uint8_t> override {
-        auto prg_mode = (control_ & 0b01100) >> 2;
-
-        if (prg_mode == 0 or prg_mode == 1) {
-            auto address = addr & 0x3FFFu;
-            auto prg_offset = (addr & 0x8000u) != 0
-                ? 1
-                : 0;
-            auto ix = (prg_ix_ * 2) + prg_offset;
-            auto& prg = prg_[ix];
-
-            return prg[address];
-        }
-
-        if (addr >= 0x8000 and addr <= 0xBFFF) {
-            auto address = addr & 0x3FFFu;
-            auto& prg = prg_mode == 3
-                ? prg_[prg_ix_ % prg_.size()]
-                : prg_.front();
+        if (addr >= 0x8000)
+            return read_prg(addr);
 
-            return prg[address];
-        }
-
-        if (addr >= 0xC000 and addr <= 0xFFFF) {
-            auto address = addr & 0x3FFFu;
-            auto& prg = prg_mode == 3
-                ? prg_.back()
-                : prg_[prg_ix_ % prg_.size()];
+        return std::nullopt;
+    }
 
-            return prg[address];
-        }
+    void save(state_writer& state) const override {
+        shift_register_.save(state);
+        state.write(control_);
+        state.write(chr_ix0_);
+        state.write(chr_ix1_);
+        state.write(prg_ix_);
+    }
 
-        return std::nullopt;
+    void load(state_reader& state) override {
+        shift_register_.load(state);
+        state.read(control_);
+        state.read(chr_ix0_);
+        state.read(chr_ix1_);
+        state.read(prg_ix_);
+
+        set_mirroring();
+        map_prg_banks();
+        invalidate_pattern_table(0);
+        invalidate_pattern_table(1);
     }
 
     constexpr void set_mirroring() noexcept {
@@ -148,9 +171,29 @@ public:
         }
     }
 
+protected:
+    [[nodiscard]] auto decoded_pattern_table(int ix) const noexcept -> const nes::pattern_table& override {
+        return rom_->pattern_table(((ix & 1) == 0 ? chr_ix0_ : chr_ix1_) % rom_->chr_banks());
+    }
+
 private:
-    std::vector<std::array<std::uint8_t, 16_Kb>> prg_;
-    std::vector<membank<4_Kb>> chr_;
+    void map_prg_banks() noexcept {
+        auto prg_mode = (control_ & 0b01100) >> 2;
+        auto bank = [this](std::size_t ix) { return rom_->prg_bank(ix % rom_->prg_banks()); };
+
+        if (prg_mode == 0 or prg_mode == 1) {// 32 KB at $8000
+            map_prg(0x8000, bank(prg_ix_ & 0x0E));
+            map_prg(0xC000, bank((prg_ix_ & 0x0E) + 1));
+        } else if (prg_mode == 2) {// first bank at $8000, switch $C000
+            map_prg(0x8000, bank(0));
+            map_prg(0xC000, bank(prg_ix_ & 0x0F));
+        } else {// switch $8000, last bank at $C000
+            map_prg(0x8000, bank(prg_ix_ & 0x0F));
+            map_prg(0xC000, bank(rom_->prg_banks() - 1));
+        }
+    }
+
+    std::shared_ptr<const rom_image> rom_;
 
     mmc1_shift_register shift_register_;
     std::uint8_t control_{0x0C};
@@ -4,6 +4,7 @@
 #include <libnes/ppu_name_table.hpp>
 
 #include <array>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -13,14 +14,22 @@ namespace nes
 class nrom final: public cartridge
 {
 public:
-    nrom(std::vector<std::array<std::uint8_t, 16_Kb>> prg, membank<4_Kb> chr0, membank<4_Kb> chr1, name_table_mirroring mirroring)
-        : prg_{std::move(prg)}
-        , chr0_{chr0}
-        , chr1_{chr1}
-        , mirroring_{mirroring} {}
-
-    [[nodiscard]] auto chr0() const noexcept -> const membank<4_Kb>& override { return chr0_; }
-    [[nodiscard]] auto chr1() const noexcept -> const membank<4_Kb>& override { return chr1_; }
+    // One or two PRG banks, one or two CHR banks (the same at $0000 and $1000)
+    nrom(std::shared_ptr<const rom_image> rom, name_table_mirroring mirroring)
+        : rom_{std::move(rom)}
+        , mirroring_{mirroring} {
+        if (rom_->chr_banks() == 0)
+            throw std::invalid_argument("NROM without CHR ROM");
+
+        map_prg(0x8000, rom_->prg_bank(0));
+        map_prg(0xC000, rom_->prg_bank(rom_->prg_banks() - 1));
+    }
+
+    nrom(const std::vector<std::array<std::uint8_t, 16_Kb>>& prg, membank<4_Kb> chr0, membank<4_Kb> chr1, name_table_mirroring mirroring)
+        : nrom{std::make_shared<const rom_image>(prg, std::array{chr0, chr1}), mirroring} {}
+
+    [[nodiscard]] auto chr0() const noexcept -> std::span<const std::uint8_t, 4_Kb> override { return rom_->chr_bank(0); }
+    [[nodiscard]] auto chr1() const noexcept -> std::span<const std::uint8_t, 4_Kb> override { return rom_->chr_bank(1 % rom_->chr_banks()); }
     [[nodiscard]] auto mirroring() const noexcept -> name_table_mirroring override { return mirroring_; }
 
     auto write([[maybe_unused]] std::uint16_t addr, [[maybe_unused]] std::uint8_t value) -> bool override {
@@ -28,27 +37,19 @@ public:
     }
 
     [[nodiscard]] auto read(std::uint16_t addr) -> std::optional<std::uint8_t> override {
-        if (addr >= 0x8000 and addr <= 0xBFFF) {
-            auto address = addr & 0x3FFFu;
-            auto& prg = prg_.front();
-
-            return prg[address];
-        }
-
-        if (addr >= 0x8000 and addr <= 0xFFFF) {
-            auto address = addr & 0x3FFFu;
-            auto& prg = prg_.back();
-
-            return prg[address];
-        }
+        if (addr >= 0x8000)
+            return read_prg(addr);
 
         return std::nullopt;
     }
 
+protected:
+    [[nodiscard]] auto decoded_pattern_table(int ix) const noexcept -> const nes::pattern_table& override {
+        return rom_->pattern_table(static_cast<std::size_t>(ix) % rom_->chr_banks());
+    }
+
 private:
-    std::vector<std::array<std::uint8_t, 16_Kb>> prg_;
-    membank<4_Kb> chr0_;
-    membank<4_Kb> chr1_;
+    std::shared_ptr<const rom_image> rom_;
     name_table_mirroring mirroring_;
 };
 
@@ -1,18 +1,24 @@
 #pragma once
 
 #include <libnes/ppu_crt_scan.hpp>
+#include <libnes/ppu_line_compositor.hpp>
 #include <libnes/ppu_name_table.hpp>
 #include <libnes/ppu_object_attribute_memory.hpp>
 #include <libnes/ppu_palette_table.hpp>
+#include <libnes/ppu_pattern_table.hpp>
 
 #include <libnes/color.hpp>
 #include <libnes/screen.hpp>
 
 #include "cartridge.hpp"
 #include "ppu_registers.hpp"
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <optional>
+#include <span>
+#include <tuple>
+#include <vector>
 
 namespace nes
 {
@@ -50,7 +56,7 @@ public:
     bool nmi_seen{false};
 
     int address_latch{0};
-    std::uint16_t address;
+    std::uint16_t address{0};
     std::uint8_t data_buffer;
 
     template <screen screen_t>
@@ -59,8 +65,44 @@ public:
     template <screen screen_t>
     constexpr void tick(screen_t& screen);
 
+    template <screen screen_t>
+    constexpr auto run(screen_t& screen, std::int64_t dots) -> std::int64_t;
+
     [[nodiscard]] constexpr auto is_frame_ready() const noexcept { return scan_.is_frame_finished(); }
 
+    // Number of dots to run until the next dot that can change the NMI line (the first dot
+    // of the pre-render line and of every vblank line) has been processed
+    [[nodiscard]] constexpr auto dots_to_nmi_edge() const noexcept -> std::int64_t {
+        auto line = scan_.line();
+        auto cycle = scan_.cycle();
+
+        if (cycle == 0 and (scan_.is_prerender() or scan_.is_vblank()))
+            return 1;
+
+        auto next_line = line < VISIBLE_SCANLINES + POST_RENDER_SCANLINES
+            ? VISIBLE_SCANLINES + POST_RENDER_SCANLINES
+            : line + 1;
+
+        return (next_line - line) * SCANLINE_DOTS - cycle + 1;
+    }
+
+    // Number of dots from now during which reading PPUSTATUS returns what it would now and
+    // changes nothing, as far as can be told without rendering ahead: sprite 0 hit and
+    // overflow may come on any visible dot
+    [[nodiscard]] constexpr auto dots_status_unchanged() const noexcept -> std::int64_t {
+        if (status & 0x80)
+            return 0;// the next read clears vblank
+
+        const auto sprite_flags_set = (status & 0x60) == 0x60;
+        if (scan_.is_visible() and not sprite_flags_set)
+            return 0;
+
+        if (scan_.is_prerender() and not sprite_flags_set)
+            return std::min<std::int64_t>(dots_to_nmi_edge() - 1, SCANLINE_DOTS - scan_.cycle());
+
+        return dots_to_nmi_edge() - 1;
+    }
+
     [[nodiscard]] constexpr auto read(std::uint16_t addr) -> std::optional<std::uint8_t> {
         switch (addr) {
             case 0x2002:
@@ -79,6 +121,10 @@ public:
                 control.assign(value);
                 return;
             }
+            case 0x2001: {
+                mask = value;
+                return;
+            }
             case 0x2003: {
                 write_oama(value);
                 return;
@@ -111,6 +157,11 @@ public:
     [[nodiscard]] constexpr auto palette_table() const -> const auto& { return palette_table_; }
     [[nodiscard]] constexpr auto oam() const -> const auto& { return oam_; }
 
+    // Registers, memories and the scan position. The line being drawn is not part of it,
+    // states are taken between frames.
+    void save(state_writer& state) const;
+    void load(state_reader& state);
+
     [[nodiscard]] constexpr static auto nametable_address(int nametable_index_x, int nametable_index_y) {
         auto index = (nametable_index_y << 1) | nametable_index_x;
         return index << 10;
@@ -144,18 +195,20 @@ public:
 
     auto display_pattern_table(auto i, auto palette) const -> std::array<color, 128 * 128>;
 
-    template <screen screen_t>
+    template <rgb_screen screen_t>
     void render_nametables(screen_t& screen);
 
-    template <screen screen_t>
+    template <rgb_screen screen_t>
     void render_noise(auto get_noise, screen_t& screen) {
         // The sky above the port was the color of television, tuned to a dead channel
-        for (auto x = 0; x < screen.width(); ++x) {
-            for (auto y = 0; y < screen.height(); ++y) {
+        auto row = std::vector<color>(static_cast<std::size_t>(screen.width()));
+
+        for (short y = 0; y < screen.height(); ++y) {
+            for (auto& pixel: row) {
                 auto r = get_noise();
-                auto pixel = color{r << 16, r << 8, r};
-                screen.draw_pixel({x, y}, pixel);
+                pixel = color{r << 16, r << 8, r};
             }
+            draw_span(screen, {0, y}, row);
         }
     }
 
@@ -189,11 +242,11 @@ private:
     [[nodiscard]] constexpr auto read_chr(std::uint16_t addr) const -> std::uint8_t {
         assert(addr < 0x2000);
 
-        auto& chr = (addr < 0x1000)
+        auto chr = (addr < 0x1000)
             ? cartridge_->chr0()
             : cartridge_->chr1();
 
-        return chr.at(addr % 0x1000);
+        return chr[addr % 0x1000];
     }
 
     constexpr void write_oama(std::uint8_t value) { oam_.address = value; }
@@ -233,7 +286,7 @@ private:
         address += control.vram_address_increment();
     }
 
-    constexpr void prerender_scanline_old() noexcept;
+    constexpr void prerender_span(short from, short to) noexcept;
     constexpr void prerender_scanline() noexcept;
 
     std::uint8_t nametable_index_x_{0};
@@ -248,23 +301,7 @@ private:
     }
 
     [[nodiscard]] constexpr auto read_tile_pixel(auto ix, auto tile, auto x, auto y) const {
-        const auto tile_offset = ix * 0x1000 + tile * 0x10;
-        const auto tile_lsb = read_chr(static_cast<std::uint16_t>(tile_offset + y + 0));
-        const auto tile_msb = read_chr(static_cast<std::uint16_t>(tile_offset + y + 8));
-        const auto pixel_lo = (tile_lsb >> (7 - x)) & 0x01;
-        const auto pixel_hi = (tile_msb >> (7 - x)) & 0x01;
-        return static_cast<std::uint8_t>(pixel_lo | (pixel_hi << 1));
-    }
-
-    [[nodiscard]] constexpr auto read_tile_pixel16(auto tile, auto x, auto y, bool flipped_vertically) {
-        const auto first_bite = (y < 8) == !flipped_vertically;// either top half of the sprite and not flipped
-                                                               // or bottom half and flipped
-        const auto tile_offset = (tile & 0x1) * 0x1000 + (tile & 0xFE) * 0x10 + (first_bite ? 0 : 1);
-        const auto tile_lsb = read_chr(static_cast<std::uint16_t>(tile_offset + y + 0));
-        const auto tile_msb = read_chr(static_cast<std::uint16_t>(tile_offset + y + 8));
-        const auto pixel_lo = (tile_lsb >> (7 - x)) & 0x01;
-        const auto pixel_hi = (tile_msb >> (7 - x)) & 0x01;
-        return static_cast<std::uint8_t>(pixel_lo | (pixel_hi << 1));
+        return cartridge_->pattern_table(ix).pixel(static_cast<std::uint8_t>(tile), x, y);
     }
 
     [[nodiscard]] constexpr static auto read_tile_index(const auto& name_table, auto tile_x, auto tile_y, auto nametable_index) -> std::uint8_t {
@@ -289,41 +326,117 @@ private:
         return tile_palette(tile_x, tile_y, attr_byte);
     }
 
-    template <screen screen_t>
-    constexpr void visible_scanline_old(screen_t& screen) {
-        auto y = scan_.line();
-        auto x = static_cast<short>(scan_.cycle() - 2);
+    // Fetches background pixels [x_begin, x_end) of the line into the compositor, every tile once
+    void render_background(short y, short x_begin, short x_end) {
+        auto [nametable_index_y, tile_y] = tile_y_scrolled(y);
+        auto tile_row = (y + scroll_y) % 8;
+        const auto& pattern_table = cartridge_->pattern_table(control.pattern_table_bg_index());
 
-        if (x >= 0 and x < 256) {
+        for (auto x = x_begin; x < x_end;) {
             auto [nametable_index_x, tile_x] = tile_x_scrolled(x);
-            auto [nametable_index_y, tile_y] = tile_y_scrolled(y);
-
-            auto tile_row = (y + scroll_y) % 8;
-            auto tile_col = (x + scroll_x) % 8;
-
             auto nametable_addr = nametable_address(nametable_index_x, nametable_index_y);
 
             auto tile_index = read_tile_index(name_table_, tile_x, tile_y, nametable_addr);
-            auto pixel = read_tile_pixel(control.pattern_table_bg_index(), tile_index, tile_col, tile_row);
             auto palette = read_tile_palette(name_table_, tile_x, tile_y, nametable_addr);
+            const auto& pixels = pattern_table.tile_row(tile_index, tile_row);
+
+            for (auto tile_col = (x + scroll_x) % 8; tile_col < 8 and x < x_end; ++tile_col, ++x) {
+                auto pixel = pixels[tile_col];
+                line_.background[x] = pixel ? static_cast<std::uint8_t>((palette << 2) | pixel) : 0;
+            }
+        }
+    }
+
+    // Picks the first 8 sprites in OAM order covering line y and draws them into the compositor,
+    // or only sprite 0 when nothing but its hit matters. Returns whether sprite 0 is drawn.
+    auto evaluate_sprites(short y, bool sprite_zero_only = false) -> bool {
+        const auto height = control.sprite_size() == sprite_size::sprite8x8 ? 8 : 16;
+        auto count = 0;
+        auto sprite_zero = false;
+
+        if (not sprite_zero_only)
+            line_.clear_sprites();
+
+        for (auto i = 0; i < 64; ++i) {
+            const auto& s = oam_.sprites[i];
+            auto row = y - s.y;
+            if (row < 0 or row >= height)
+                continue;
 
-            screen.draw_pixel({x, y}, palette_table_.color_of(pixel, palette));
-
-            // Sprite 0 hit
-            auto s = oam_.sprites[0];
-            if (x >= s.x and x < s.x + 8 and y >= s.y and y < s.y + 8 /* and pixel != 0*/) {
-                auto dx = x - s.x;
-                auto dy = y - s.y;
-                auto j = (s.attr & 0x40) ? 7 - dx : dx;
-                auto i = (s.attr & 0x80) ? 7 - dy : dy;
-                auto sprite_pixel = read_tile_pixel(control.pattern_table_fg_index(), s.tile, j, i);
-                if (sprite_pixel != 0) {
+            if (++count > 8) {
+                status |= 0x20;// sprite overflow
+                break;
+            }
+
+            if (i == 0) {
+                sprite_zero = true;
+                if (sprite_zero_only)
+                    line_.clear_sprites();
+            } else if (sprite_zero_only) {
+                continue;
+            }
+
+            if (s.attr & 0x80)// flipped vertically
+                row = height - 1 - row;
+
+            const auto& pixels = height == 8
+                ? cartridge_->pattern_table(control.pattern_table_fg_index()).tile_row(s.tile, row)
+                : cartridge_->pattern_table(s.tile & 0x01).tile_row(static_cast<std::uint8_t>((s.tile & 0xFE) + (row >> 3)), row & 0x07);
+
+            line_.draw_sprite(s.x, pixels, static_cast<std::uint8_t>(s.attr & 0x03), (s.attr & 0x40) != 0, (s.attr & 0x20) != 0, i == 0);
+        }
+
+        return sprite_zero;
+    }
+
+    // Dots [from, to) of a visible line; pixel x is output on dot x + 2
+    template <screen screen_t>
+    constexpr void visible_span(screen_t& screen, short from, short to) {
+        auto y = scan_.line();
+        auto x_begin = static_cast<short>(std::max(from - 2, 0));
+        auto x_end = static_cast<short>(std::min(to - 2, 256));
+
+        if constexpr (headless_screen<screen_t>) {
+            // Only sprite 0 hit is worked out, on the lines sprite 0 is on until it's set
+            if (from == 0)
+                sprite_zero_on_line_ = evaluate_sprites(y, true);
+
+            if (x_begin < x_end and sprite_zero_on_line_ and (status & 0x40) == 0) {
+                render_background(y, x_begin, x_end);
+
+                if (line_.compose(x_begin, x_end, output_))
                     status |= 0x40;
+            }
+        } else {
+            if (from == 0)
+                evaluate_sprites(y);
+
+            if (x_begin < x_end) {
+                render_background(y, x_begin, x_end);
+
+                if (line_.compose(x_begin, x_end, output_))
+                    status |= 0x40;// sprite 0 hit
+
+                const auto span = static_cast<std::size_t>(x_end - x_begin);
+
+                if constexpr (indexed_screen<screen_t>) {
+                    if (x_begin == 0)
+                        screen.emphasize(y, static_cast<std::uint8_t>(mask >> 5));
+
+                    for (auto x = x_begin; x < x_end; ++x)// palette RAM address to system palette index
+                        output_[x] = palette_table_.index_of(output_[x] & 0x03, output_[x] >> 2);
+
+                    draw_span(screen, {x_begin, y}, std::span<const std::uint8_t>{output_}.subspan(x_begin, span));
+                } else {
+                    for (auto x = x_begin; x < x_end; ++x)
+                        colors_[x] = palette_table_.color_of(output_[x] & 0x03, output_[x] >> 2);
+
+                    draw_span(screen, {x_begin, y}, std::span<const color>{colors_}.subspan(x_begin, span));
                 }
             }
         }
 
-        if (scan_.cycle() == 257) {
+        if (from <= 257 and to > 257) {
             scroll_x = scroll_x_buffer;
             nametable_index_x_ = control.nametable_index_x();
         }
@@ -335,32 +448,6 @@ private:
     template <screen screen_t>
     constexpr void postrender_scanline(screen_t& screen);
 
-    template <screen screen_t>
-    constexpr void postrender_scanline_old(screen_t& screen) noexcept {
-        if (scan_.cycle() == 0) {
-            for (const auto& s: oam_.sprites) {
-                auto palette = static_cast<std::uint8_t>((s.attr & 0x03) + 4);
-
-                for (auto i = 0; i < (control.sprite_size() == sprite_size::sprite8x8 ? 8 : 16); ++i) {
-                    for (auto j = 0; j < 8; ++j) {
-                        auto pixel = control.sprite_size() == sprite_size::sprite8x8
-                            ? read_tile_pixel(control.pattern_table_fg_index(), s.tile, j, i)
-                            : read_tile_pixel16(s.tile, j, i, (s.attr & 0x80) != 0);
-                        auto dx = (s.attr & 0x40) ? 7 - j : j;// flipped horizontally
-                        auto dy = (s.attr & 0x80)             // flipped vertically
-                            ? (control.sprite_size() == sprite_size::sprite8x8 ? 7 : 15) - i
-                            : i;
-                        if (pixel) {
-                            screen.draw_pixel(
-                                {static_cast<short>(s.x + dx), static_cast<short>(s.y + dy)},
-                                palette_table_.color_of(pixel, palette)
-                            );
-                        }
-                    }
-                }
-            }
-        }
-    }
     constexpr void vertical_blank_line_old() noexcept {
 
         if (scan_.cycle() == 0) {
@@ -383,25 +470,44 @@ private:
     nes::palette_table palette_table_;
     nes::object_attribute_memory oam_;
 
+    line_compositor line_;
+    line_compositor::line output_{};
+    bool sprite_zero_on_line_{false};
+    std::array<color, line_compositor::WIDTH> colors_{};
+
     cartridge* cartridge_{nullptr};
-    std::uint8_t data_read_buffer_;
+    std::uint8_t data_read_buffer_{0};
 
     std::uint16_t addr_;
 };
 
 template <screen screen_t>
 constexpr void ppu::tick_old(screen_t& screen) {
-    if (scan_.is_prerender()) {
-        prerender_scanline_old();
-    } else if (scan_.is_visible()) {
-        visible_scanline_old(screen);
-    } else if (scan_.is_postrender()) {
-        postrender_scanline_old(screen);
-    } else if (scan_.is_vblank()) {
-        vertical_blank_line_old();
+    run(screen, 1);
+}
+
+template <screen screen_t>
+constexpr auto ppu::run(screen_t& screen, std::int64_t dots) -> std::int64_t {
+    for (auto i = std::int64_t{0}; i < dots;) {
+        auto from = scan_.cycle();
+        auto to = static_cast<short>(std::min<std::int64_t>(SCANLINE_DOTS, from + dots - i));
+
+        if (scan_.is_prerender()) {
+            prerender_span(from, to);
+        } else if (scan_.is_visible()) {
+            visible_span(screen, from, to);
+        } else if (scan_.is_vblank()) {
+            vertical_blank_line_old();
+        }
+
+        scan_.advance(to - from);
+        i += to - from;
+
+        if (is_frame_ready())
+            return i;
     }
 
-    scan_.advance();
+    return dots;
 }
 
 template <screen screen_t>
@@ -422,16 +528,16 @@ constexpr void ppu::tick(screen_t& screen) {
 
 inline auto ppu::display_pattern_table(auto i, auto palette) const -> std::array<color, 128 * 128> {
     auto result = std::array<color, 128 * 128>{};
+    const auto& pattern_table = cartridge_->pattern_table(i);
 
     for (std::uint16_t tile_y = 0; tile_y < 16; ++tile_y) {
         for (std::uint16_t tile_x = 0; tile_x < 16; ++tile_x) {
-            auto offset = static_cast<std::uint16_t>(tile_y * 16 + tile_x);
+            auto offset = static_cast<std::uint8_t>(tile_y * 16 + tile_x);
             for (std::uint16_t row = 0; row < 8; ++row) {
+                const auto& pixels = pattern_table.tile_row(offset, row);
                 for (std::uint16_t col = 0; col < 8; col++) {
-                    auto pixel = read_tile_pixel(i, offset, col, row);
-
                     auto result_offset = (tile_y * 8 + row) * 128 + tile_x * 8 + (7 - col);
-                    auto result_color = palette_table_.color_of(pixel, palette);
+                    auto result_color = palette_table_.color_of(pixels[col], palette);
 
                     result[result_offset] = result_color;
                 }
@@ -441,14 +547,66 @@ inline auto ppu::display_pattern_table(auto i, auto palette) const -> std::array
     return result;
 }
 
-constexpr void ppu::prerender_scanline_old() noexcept {
-    if (scan_.cycle() == 0) {
+inline void ppu::save(state_writer& state) const {
+    state.write(control.value());
+    state.write(status);
+    state.write(mask);
+
+    state.write(static_cast<std::uint8_t>(scroll_latch));
+    state.write(scroll_x);
+    state.write(scroll_y);
+    state.write(scroll_x_buffer);
+    state.write(scroll_y_buffer);
+    state.write(nametable_index_x_);
+    state.write(nametable_index_y_);
+
+    state.write(nmi_raised);
+    state.write(nmi_seen);
+
+    state.write(static_cast<std::uint8_t>(address_latch));
+    state.write(address);
+    state.write(data_read_buffer_);
+
+    scan_.save(state);
+    name_table_.save(state);
+    palette_table_.save(state);
+    oam_.save(state);
+}
+
+inline void ppu::load(state_reader& state) {
+    control.assign(state.read<std::uint8_t>());
+    state.read(status);
+    state.read(mask);
+
+    scroll_latch = state.read<std::uint8_t>() & 0x01;
+    state.read(scroll_x);
+    state.read(scroll_y);
+    state.read(scroll_x_buffer);
+    state.read(scroll_y_buffer);
+    nametable_index_x_ = state.read<std::uint8_t>() & 0x01;
+    nametable_index_y_ = state.read<std::uint8_t>() & 0x01;
+
+    state.read(nmi_raised);
+    state.read(nmi_seen);
+
+    address_latch = state.read<std::uint8_t>() & 0x01;
+    state.read(address);
+    state.read(data_read_buffer_);
+
+    scan_.load(state);
+    name_table_.load(state);
+    palette_table_.load(state);
+    oam_.load(state);
+}
+
+constexpr void ppu::prerender_span(short from, short to) noexcept {
+    if (from == 0) {
         status = 0x00;
         control.smb_hotfix();
         nmi_raised = false;
         nmi_seen = false;
     }
-    if (scan_.cycle() >= 280) {
+    if (to > 280) {
         scroll_y = scroll_y_buffer;
         nametable_index_y_ = control.nametable_index_y();
     }
@@ -505,8 +663,10 @@ template <screen screen_t>
 constexpr void ppu::postrender_scanline(screen_t& screen) {
 }
 
-template <screen screen_t>
+template <rgb_screen screen_t>
 void ppu::render_nametables(screen_t& screen) {
+    auto row = std::array<color, 256 * 2>{};
+
     for (auto y: std::views::iota(short{0}, short{256 * 2})) {
         for (auto x: std::views::iota(short{0}, short{256 * 2})) {
             const auto y_of_tile = (y % 256) / 8;
@@ -520,8 +680,9 @@ void ppu::render_nametables(screen_t& screen) {
             auto pixel = read_tile_pixel(control.pattern_table_bg_index(), tile_index, x_in_tile, y_in_tile);
             auto palette = read_tile_palette(name_table_, x_of_tile, y_of_tile, nametable_addr);
 
-            screen.draw_pixel({x, y}, palette_table_.color_of(pixel, palette));
+            row[x] = palette_table_.color_of(pixel, palette);
         }
+        draw_span(screen, {0, y}, row);
     }
 }
 
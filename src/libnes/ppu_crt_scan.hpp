@@ -1,5 +1,9 @@
 #pragma once
 
+#include <libnes/savestate.hpp>
+
+#include <cassert>
+
 namespace nes
 {
 
@@ -45,6 +49,31 @@ public:
         }
     }
 
+    // Skip several dots at once, never past the end of the current line
+    constexpr void advance(int dots) noexcept {
+        assert(dots > 0 and cycle_ + dots <= dots_);
+
+        cycle_ += dots - 1;
+        advance();
+    }
+
+    void save(state_writer& state) const {
+        state.write(line_);
+        state.write(cycle_);
+        state.write(frame_is_odd_);
+    }
+
+    void load(state_reader& state) {
+        auto line = state.read<short>();
+        auto cycle = state.read<short>();
+        if (line < -1 or line >= visible_scanlines_ + postrender_scanlines_ + vblank_scanlines_ or cycle < 0 or cycle >= dots_)
+            throw bad_savestate("scan position out of range");
+
+        line_ = line;
+        cycle_ = cycle;
+        state.read(frame_is_odd_);
+    }
+
 private:
     int dots_;
     int visible_scanlines_;
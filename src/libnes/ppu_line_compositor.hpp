@@ -0,0 +1,121 @@
+#pragma once
+
+#include <libnes/ppu_pattern_table.hpp>
+
+#include <array>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define NES_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace nes
+{
+
+// Merges the background and sprite layers of one scanline into palette RAM addresses.
+// Every layer is a 256-entry buffer, a zero entry being a transparent pixel.
+class line_compositor
+{
+public:
+    static constexpr auto WIDTH = 256;
+    static constexpr std::uint8_t ALL = 0xFF;
+
+    using line = std::array<std::uint8_t, WIDTH>;
+
+    line background{};    // palette << 2 | pixel
+    line sprites{};       // 0x10 | palette << 2 | pixel of the front-most sprite
+    line sprites_behind{};// ALL where that sprite is behind the background
+    line sprite_zero{};   // ALL where that sprite is sprite 0
+
+    constexpr void clear_sprites() noexcept {
+        sprites.fill(0);
+        sprites_behind.fill(0);
+        sprite_zero.fill(0);
+    }
+
+    // Sprites have to be drawn front to back, i.e. in OAM order
+    constexpr void draw_sprite(int x, const pattern_table::row& pixels, std::uint8_t palette, bool flipped_horizontally, bool behind, bool is_sprite_zero) noexcept {
+        for (auto dx = 0; dx < 8 and x + dx < WIDTH; ++dx) {
+            const auto pixel = pixels[flipped_horizontally ? 7 - dx : dx];
+            const auto sx = x + dx;
+
+            if (pixel == 0 or sprites[sx] != 0)
+                continue;
+
+            sprites[sx] = static_cast<std::uint8_t>(0x10 | (palette << 2) | pixel);
+            sprites_behind[sx] = behind ? ALL : 0;
+            sprite_zero[sx] = is_sprite_zero and sx != WIDTH - 1 ? ALL : 0;// no hit at x=255
+        }
+    }
+
+    // Composes pixels [x_begin, x_end) into output, returns true on sprite 0 hit
+    auto compose(int x_begin, int x_end, line& output) const noexcept -> bool {
+        auto x = x_begin;
+        auto hit = false;
+
+#if defined(__AVX2__)
+        for (; x + 32 <= x_end; x += 32)
+            hit |= compose_avx2(x, output);
+#endif
+#if defined(NES_HAS_SSE2)
+        for (; x + 16 <= x_end; x += 16)
+            hit |= compose_sse2(x, output);
+#endif
+        for (; x < x_end; ++x)
+            hit |= compose_scalar(x, output);
+
+        return hit;
+    }
+
+    constexpr auto compose_scalar(int x, line& output) const noexcept -> bool {
+        const auto bg_opaque = background[x] != 0;
+        const auto show_bg = sprites[x] == 0 or (sprites_behind[x] != 0 and bg_opaque);
+
+        output[x] = show_bg ? background[x] : sprites[x];
+        return bg_opaque and sprite_zero[x] != 0;
+    }
+
+private:
+#if defined(__AVX2__)
+    auto compose_avx2(int x, line& output) const noexcept -> bool {
+        const auto zero = _mm256_setzero_si256();
+        const auto bg = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(background.data() + x));
+        const auto spr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sprites.data() + x));
+        const auto behind = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sprites_behind.data() + x));
+        const auto spr0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sprite_zero.data() + x));
+
+        const auto bg_transparent = _mm256_cmpeq_epi8(bg, zero);
+        const auto hidden = _mm256_andnot_si256(bg_transparent, behind);
+        const auto show_bg = _mm256_or_si256(_mm256_cmpeq_epi8(spr, zero), hidden);
+        const auto result = _mm256_or_si256(_mm256_and_si256(show_bg, bg), _mm256_andnot_si256(show_bg, spr));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output.data() + x), result);
+        return _mm256_movemask_epi8(_mm256_andnot_si256(bg_transparent, spr0)) != 0;
+    }
+#endif
+
+#if defined(NES_HAS_SSE2)
+    auto compose_sse2(int x, line& output) const noexcept -> bool {
+        const auto zero = _mm_setzero_si128();
+        const auto bg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background.data() + x));
+        const auto spr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprites.data() + x));
+        const auto behind = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprites_behind.data() + x));
+        const auto spr0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprite_zero.data() + x));
+
+        const auto bg_transparent = _mm_cmpeq_epi8(bg, zero);
+        const auto hidden = _mm_andnot_si128(bg_transparent, behind);
+        const auto show_bg = _mm_or_si128(_mm_cmpeq_epi8(spr, zero), hidden);
+        const auto result = _mm_or_si128(_mm_and_si128(show_bg, bg), _mm_andnot_si128(show_bg, spr));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output.data() + x), result);
+        return _mm_movemask_epi8(_mm_andnot_si128(bg_transparent, spr0)) != 0;
+    }
+#endif
+};
+
+}// namespace nes
@@ -9,6 +9,7 @@
 #include <optional>
 
 #include <libnes/literals.hpp>
+#include <libnes/savestate.hpp>
 #include <utility>
 
 namespace nes
@@ -44,6 +45,16 @@ public:
         return vram_[bank & 1];
     }
 
+    void save(state_writer& state) const {
+        for (const auto& bank: vram_)
+            state.write(bank);
+    }
+
+    void load(state_reader& state) {
+        for (auto& bank: vram_)
+            state.read(bank);
+    }
+
 private:
     [[nodiscard]] auto bank_index(std::uint16_t addr) const -> std::size_t {
         using enum name_table_mirroring;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <libnes/savestate.hpp>
+
 #include <array>
 #include <cstdint>
 #include <bit>
@@ -38,6 +40,26 @@ public:
         ram[address++] = data;
     }
 
+    void save(state_writer& state) const {
+        for (const auto& s: sprites) {
+            state.write(s.y);
+            state.write(s.tile);
+            state.write(s.attr);
+            state.write(s.x);
+        }
+        state.write(address);
+    }
+
+    void load(state_reader& state) {
+        for (auto& s: sprites) {
+            state.read(s.y);
+            state.read(s.tile);
+            state.read(s.attr);
+            state.read(s.x);
+        }
+        state.read(address);
+    }
+
     std::uint8_t address{0};
 };
 
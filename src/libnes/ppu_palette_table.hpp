@@ -1,6 +1,7 @@
 #pragma once
 
 #include <libnes/color.hpp>
+#include <libnes/savestate.hpp>
 
 #include <array>
 #include <cstdint>
@@ -34,11 +35,20 @@ public:
         palette_ram_[palette_address(address)] = value;
     }
 
-    [[nodiscard]] auto color_of(std::uint8_t pixel, std::uint8_t palette) const noexcept -> color {
+    [[nodiscard]] constexpr auto index_of(std::uint8_t pixel, std::uint8_t palette) const noexcept -> std::uint8_t {
         auto rpc = pixel ? read((palette << 2) + pixel) : read(0x00);
-        return system_colors_[rpc & 0x3F];
+        return rpc & 0x3F;
+    }
+
+    [[nodiscard]] auto color_of(std::uint8_t pixel, std::uint8_t palette) const noexcept -> color {
+        return system_colors_[index_of(pixel, palette)];
     }
 
+    [[nodiscard]] constexpr auto system_colors() const noexcept -> const std::array<color, 64>& { return system_colors_; }
+
+    void save(state_writer& state) const { state.write(palette_ram_); }
+    void load(state_reader& state) { state.read(palette_ram_); }
+
 private:
     std::array<std::uint8_t, 32> palette_ram_{};
     const std::array<color, 64>& system_colors_;
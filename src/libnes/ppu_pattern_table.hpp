@@ -0,0 +1,50 @@
+#pragma once
+
+#include <libnes/literals.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace nes
+{
+
+// 4 KB of CHR data (256 tiles of two bitplanes) decoded to one byte per pixel
+class pattern_table
+{
+public:
+    using row = std::array<std::uint8_t, 8>;// pixels left to right
+
+    constexpr void decode(std::span<const std::uint8_t, 4_Kb> chr) noexcept {
+        for (auto tile = 0; tile < 256; ++tile) {
+            for (auto y = 0; y < 8; ++y) {
+                decode_row(chr, tile, y);
+            }
+        }
+    }
+
+    constexpr void decode_row(std::span<const std::uint8_t, 4_Kb> chr, int tile, int y) noexcept {
+        const auto tile_lsb = chr[tile * 0x10 + y + 0];
+        const auto tile_msb = chr[tile * 0x10 + y + 8];
+
+        auto& r = rows_[tile * 8 + y];
+        for (auto x = 0; x < 8; ++x) {
+            const auto pixel_lo = (tile_lsb >> (7 - x)) & 0x01;
+            const auto pixel_hi = (tile_msb >> (7 - x)) & 0x01;
+            r[x] = static_cast<std::uint8_t>(pixel_lo | (pixel_hi << 1));
+        }
+    }
+
+    [[nodiscard]] constexpr auto tile_row(std::uint8_t tile, int y) const noexcept -> const row& {
+        return rows_[tile * 8 + y];
+    }
+
+    [[nodiscard]] constexpr auto pixel(std::uint8_t tile, int x, int y) const noexcept {
+        return rows_[tile * 8 + y][x];
+    }
+
+private:
+    std::array<row, 256 * 8> rows_{};
+};
+
+}// namespace nes
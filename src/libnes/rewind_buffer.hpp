@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace nes
+{
+
+// Saved states of the last frames, to step back through one at a time. Only the newest is
+// kept whole; each one before it is the XOR of it and the one after, run length encoded,
+// which leaves a few hundred bytes for a frame. They go in a ring of a fixed size, and the
+// oldest are dropped to make room. Once the buffers have grown to the size of a state
+// nothing is allocated any more.
+class rewind_buffer
+{
+public:
+    explicit rewind_buffer(std::size_t capacity, std::size_t max_snapshots)
+        : ring_(capacity)
+        , entries_(max_snapshots) {}
+
+    // Makes state the newest snapshot
+    void push(std::span<const std::uint8_t> state) {
+        if (state.size() != newest_.size()) {// another console
+            clear();
+            newest_.assign(state.begin(), state.end());
+            has_newest_ = true;
+            return;
+        }
+
+        if (has_newest_) {
+            encode_delta(state);
+            store(delta_);
+        }
+
+        std::ranges::copy(state, newest_.begin());
+        has_newest_ = true;
+    }
+
+    // Drops the newest snapshot and returns the one before it, which is the newest then.
+    // Empty when there is none; the span is good until the next push or pop.
+    auto pop() -> std::span<const std::uint8_t> {
+        if (count_ == 0)
+            return {};
+
+        const auto& entry = entries_[(first_ + count_ - 1) % entries_.size()];
+        apply_delta(std::span{ring_}.subspan(entry.offset, entry.size));
+
+        end_ = entry.offset;
+        --count_;
+        return newest_;
+    }
+
+    void clear() noexcept {
+        first_ = 0;
+        count_ = 0;
+        end_ = 0;
+        has_newest_ = false;
+    }
+
+    // The newest snapshot as it is, empty before the first push; good until the next push or
+    // pop
+    [[nodiscard]] auto newest() const noexcept -> std::span<const std::uint8_t> {
+        return has_newest_ ? std::span{newest_} : std::span<const std::uint8_t>{};
+    }
+
+    // Snapshots that can be stepped back to
+    [[nodiscard]] auto size() const noexcept { return count_; }
+
+    // Bytes of the ring taken by them
+    [[nodiscard]] auto bytes_used() const noexcept {
+        auto used = std::size_t{0};
+        for (auto i = std::size_t{0}; i < count_; ++i)
+            used += entries_[(first_ + i) % entries_.size()].size;
+        return used;
+    }
+
+private:
+    struct entry {
+        std::size_t offset{0};
+        std::size_t size{0};
+    };
+
+    // Runs of (unchanged bytes, changed bytes, the XOR of the changed bytes), the lengths as
+    // base 128 varints. Unchanged runs shorter than this stay part of the changed ones.
+    static constexpr std::size_t MIN_UNCHANGED_RUN = 4;
+
+    void encode_delta(std::span<const std::uint8_t> state) {
+        delta_.clear();
+
+        for (auto i = std::size_t{0}; i < state.size();) {
+            const auto unchanged_from = i;
+            while (i < state.size() and state[i] == newest_[i])
+                ++i;
+
+            const auto changed_from = i;
+            for (auto unchanged = std::size_t{0}; i < state.size() and unchanged < MIN_UNCHANGED_RUN; ++i)
+                unchanged = state[i] == newest_[i] ? unchanged + 1 : 0;
+
+            auto changed_to = i;
+            while (changed_to > changed_from and state[changed_to - 1] == newest_[changed_to - 1])
+                --changed_to;
+            i = changed_to;
+
+            put_varint(changed_from - unchanged_from);
+            put_varint(changed_to - changed_from);
+            for (auto j = changed_from; j < changed_to; ++j)
+                delta_.push_back(static_cast<std::uint8_t>(state[j] ^ newest_[j]));
+        }
+    }
+
+    void apply_delta(std::span<const std::uint8_t> delta) {
+        for (auto at = std::size_t{0}; not delta.empty();) {
+            at += take_varint(delta);
+            const auto changed = take_varint(delta);
+
+            for (auto j = std::size_t{0}; j < changed; ++j)
+                newest_[at + j] ^= delta[j];
+
+            at += changed;
+            delta = delta.subspan(changed);
+        }
+    }
+
+    void put_varint(std::size_t value) {
+        for (; value >= 0x80; value >>= 7)
+            delta_.push_back(static_cast<std::uint8_t>(value | 0x80));
+        delta_.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    static auto take_varint(std::span<const std::uint8_t>& bytes) -> std::size_t {
+        auto value = std::size_t{0};
+        for (auto shift = 0;; shift += 7) {
+            const auto byte = bytes.front();
+            bytes = bytes.subspan(1);
+
+            value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+    }
+
+    // Puts delta after the newest entry, wrapping around to the start of the ring when it
+    // doesn't fit before the end, and drops the oldest entries in the way
+    void store(std::span<const std::uint8_t> delta) {
+        if (delta.size() > ring_.size() or entries_.empty()) {// can't step back past this one
+            count_ = 0;
+            end_ = 0;
+            return;
+        }
+
+        auto at = end_;
+        if (delta.size() > ring_.size() - at) {
+            while (count_ != 0 and oldest().offset >= at)
+                drop_oldest();
+            at = 0;
+        }
+
+        while (count_ != 0 and (count_ == entries_.size() or (oldest().offset >= at and oldest().offset < at + delta.size())))
+            drop_oldest();
+
+        std::ranges::copy(delta, ring_.begin() + static_cast<std::ptrdiff_t>(at));
+        entries_[(first_ + count_) % entries_.size()] = entry{at, delta.size()};
+        ++count_;
+        end_ = at + delta.size();
+    }
+
+    [[nodiscard]] auto oldest() const -> const entry& { return entries_[first_]; }
+
+    void drop_oldest() noexcept {
+        first_ = (first_ + 1) % entries_.size();
+        --count_;
+    }
+
+    std::vector<std::uint8_t> ring_;
+    std::vector<entry> entries_;
+    std::size_t first_{0};
+    std::size_t count_{0};
+    std::size_t end_{0};
+
+    std::vector<std::uint8_t> newest_;
+    bool has_newest_{false};
+    std::vector<std::uint8_t> delta_;
+};
+
+}// namespace nes
@@ -0,0 +1,237 @@
+#include <libnes/rom_file.hpp>
+
+#include <libnes/mappers/mmc1.hpp>
+#include <libnes/mappers/nrom.hpp>
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace nes::literals;
+
+namespace nes
+{
+
+namespace
+{
+
+constexpr auto HEADER_SIZE = std::size_t{16};
+constexpr auto TRAINER_SIZE = std::size_t{512};
+
+// A whole file mapped read-only, unmapped with the last reference to it
+class file_mapping
+{
+public:
+    explicit file_mapping(const std::filesystem::path& path) {
+#if defined(_WIN32)
+        auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw last_error(path);
+
+        auto size = LARGE_INTEGER{};
+        if (not GetFileSizeEx(file, &size) or size.QuadPart < static_cast<LONGLONG>(HEADER_SIZE)) {
+            auto error = last_error(path);
+            CloseHandle(file);
+            if (size.QuadPart < static_cast<LONGLONG>(HEADER_SIZE))
+                throw bad_rom("not an iNES file");
+            throw error;
+        }
+
+        auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            throw last_error(path);
+
+        data_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (data_ == nullptr)
+            throw last_error(path);
+
+        size_ = static_cast<std::size_t>(size.QuadPart);
+#else
+        auto file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            throw last_error(path);
+
+        struct stat status {};
+        if (::fstat(file, &status) != 0) {
+            auto error = last_error(path);
+            ::close(file);
+            throw error;
+        }
+
+        size_ = static_cast<std::size_t>(status.st_size);
+        if (size_ < HEADER_SIZE) {// mapping nothing fails
+            ::close(file);
+            throw bad_rom("not an iNES file");
+        }
+
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+        auto error = last_error(path);
+        ::close(file);
+        if (data_ == MAP_FAILED)
+            throw error;
+#endif
+    }
+
+    file_mapping(const file_mapping&) = delete;
+    auto operator=(const file_mapping&) -> file_mapping& = delete;
+
+    ~file_mapping() {
+#if defined(_WIN32)
+        UnmapViewOfFile(data_);
+#else
+        ::munmap(data_, size_);
+#endif
+    }
+
+    [[nodiscard]] auto bytes() const noexcept -> std::span<const std::uint8_t> {
+        return {static_cast<const std::uint8_t*>(data_), size_};
+    }
+
+private:
+    static auto last_error(const std::filesystem::path& path) -> std::system_error {
+#if defined(_WIN32)
+        return {static_cast<int>(GetLastError()), std::system_category(), "Cannot map " + path.string()};
+#else
+        return {errno, std::generic_category(), "Cannot map " + path.string()};
+#endif
+    }
+
+    void* data_{nullptr};
+    std::size_t size_{0};
+};
+
+// NES 2.0 sizes are a count of units, or 2^E * (MM * 2 + 1) when the high nibble is all set
+auto nes2_rom_size(std::uint8_t lsb, std::uint8_t msb, std::size_t unit) -> std::size_t {
+    if (msb != 0x0F)
+        return (std::size_t{msb} << 8 | lsb) * unit;
+
+    const auto exponent = lsb >> 2;
+    const auto multiplier = (lsb & 0x03) * 2 + 1;
+    if (exponent > 32)
+        throw bad_rom("ROM size out of range");
+
+    return (std::size_t{1} << exponent) * static_cast<std::size_t>(multiplier);
+}
+
+// RAM sizes are 64 << shift bytes, none for a zero shift
+auto nes2_ram_size(int shift) -> std::size_t {
+    return shift == 0 ? 0 : std::size_t{64} << shift;
+}
+
+}// namespace
+
+auto parse_ines_header(std::span<const std::uint8_t> header) -> rom_info {
+    if (header.size() < HEADER_SIZE or header[0] != 'N' or header[1] != 'E' or header[2] != 'S' or header[3] != 0x1A)
+        throw bad_rom("not an iNES file");
+
+    const auto flags6 = header[6];
+    const auto flags7 = header[7];
+
+    auto info = rom_info{};
+    info.nes2 = (flags7 & 0x0C) == 0x08;
+    info.mirroring = (flags6 & 0x01) != 0 ? name_table_mirroring::vertical : name_table_mirroring::horizontal;
+    info.battery = (flags6 & 0x02) != 0;
+    info.trainer = (flags6 & 0x04) != 0;
+    info.four_screen = (flags6 & 0x08) != 0;
+
+    if (info.nes2) {
+        info.mapper = (flags6 >> 4) | (flags7 & 0xF0) | ((header[8] & 0x0F) << 8);
+        info.submapper = header[8] >> 4;
+        info.console = static_cast<console_type>(flags7 & 0x03);
+        info.region = static_cast<tv_region>(header[12] & 0x03);
+
+        info.prg_rom_size = nes2_rom_size(header[4], header[9] & 0x0F, 16_Kb);
+        info.chr_rom_size = nes2_rom_size(header[5], header[9] >> 4, 8_Kb);
+        info.prg_ram_size = nes2_ram_size(header[10] & 0x0F);
+        info.prg_nvram_size = nes2_ram_size(header[10] >> 4);
+        info.chr_ram_size = nes2_ram_size(header[11] & 0x0F);
+        info.chr_nvram_size = nes2_ram_size(header[11] >> 4);
+
+        info.misc_roms = header[14] & 0x03;
+        info.expansion_device = header[15] & 0x3F;
+        return info;
+    }
+
+    // Old dumps have junk from byte 7 on, the high nibble of the mapper then being part of it
+    const auto junk = (flags7 & 0x0C) != 0 or header[12] != 0 or header[13] != 0 or header[14] != 0 or header[15] != 0;
+
+    info.mapper = (flags6 >> 4) | (junk ? 0 : flags7 & 0xF0);
+    info.console = junk ? console_type::nes : static_cast<console_type>(flags7 & 0x03);
+    info.region = not junk and (header[9] & 0x01) != 0 ? tv_region::pal : tv_region::ntsc;
+
+    info.prg_rom_size = header[4] * 16_Kb;
+    info.chr_rom_size = header[5] * 8_Kb;
+    info.chr_ram_size = info.chr_rom_size == 0 ? 8_Kb : 0;
+
+    const auto prg_ram = junk or header[8] == 0 ? 8_Kb : header[8] * 8_Kb;
+    (info.battery ? info.prg_nvram_size : info.prg_ram_size) = prg_ram;
+
+    return info;
+}
+
+rom_file::rom_file(const std::filesystem::path& path) {
+    auto mapping = std::make_shared<const file_mapping>(path);
+    const auto bytes = mapping->bytes();
+
+    try {
+        parse(std::move(mapping), bytes);
+    } catch (const bad_rom& e) {
+        throw bad_rom(path.string() + ": " + e.what());
+    }
+}
+
+rom_file::rom_file(std::shared_ptr<const void> storage, std::span<const std::uint8_t> bytes) {
+    parse(std::move(storage), bytes);
+}
+
+void rom_file::parse(std::shared_ptr<const void> storage, std::span<const std::uint8_t> bytes) {
+    info_ = parse_ines_header(bytes);
+
+    if (info_.prg_rom_size == 0 or info_.prg_rom_size % rom_image::PRG_BANK_SIZE != 0)
+        throw bad_rom("PRG ROM is not whole 16 KB banks");
+
+    if (info_.chr_rom_size % rom_image::CHR_BANK_SIZE != 0)
+        throw bad_rom("CHR ROM is not whole 4 KB banks");
+
+    const auto trainer_size = info_.trainer ? TRAINER_SIZE : 0;
+    if (bytes.size() < HEADER_SIZE + trainer_size + info_.prg_rom_size + info_.chr_rom_size)
+        throw bad_rom("file is truncated");
+
+    trainer_ = bytes.subspan(HEADER_SIZE, trainer_size);
+    const auto prg = bytes.subspan(HEADER_SIZE + trainer_size, info_.prg_rom_size);
+    const auto chr = bytes.subspan(HEADER_SIZE + trainer_size + info_.prg_rom_size, info_.chr_rom_size);
+
+    image_ = std::make_shared<const rom_image>(std::move(storage), prg, chr);
+}
+
+auto rom_file::make_cartridge() const -> std::unique_ptr<cartridge> {
+    if (info_.chr_rom_size == 0)
+        throw bad_rom("CHR RAM is not supported");
+
+    switch (info_.mapper) {
+        case 0:
+            if (image_->prg_banks() > 2 or image_->chr_banks() > 2)
+                throw bad_rom("NROM of more than 32 KB PRG or 8 KB CHR ROM");
+            return std::make_unique<nrom>(image_, info_.mirroring);
+        case 1:
+            return std::make_unique<mmc1>(image_);
+        default:
+            throw bad_rom("unsupported mapper " + std::to_string(info_.mapper));
+    }
+}
+
+}// namespace nes
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <libnes/cartridge.hpp>
+#include <libnes/ppu_name_table.hpp>
+#include <libnes/rom_image.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <stdexcept>
+
+namespace nes
+{
+
+class bad_rom: public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+enum class tv_region : std::uint8_t {
+    ntsc,
+    pal,
+    multiple,
+    dendy,
+};
+
+enum class console_type : std::uint8_t {
+    nes,
+    vs_system,
+    playchoice_10,
+    extended,
+};
+
+// What the 16 byte header of an iNES or NES 2.0 file tells, sizes in bytes. iNES files
+// leave out most of what NES 2.0 has, which then gets the usual defaults: 8 KB of PRG RAM
+// (battery backed with the battery bit), 8 KB of CHR RAM when there is no CHR ROM.
+struct rom_info {
+    bool nes2{false};
+    int mapper{0};
+    int submapper{0};
+    console_type console{console_type::nes};
+    tv_region region{tv_region::ntsc};
+
+    name_table_mirroring mirroring{name_table_mirroring::horizontal};
+    bool four_screen{false};
+    bool battery{false};
+    bool trainer{false};
+
+    std::size_t prg_rom_size{0};
+    std::size_t chr_rom_size{0};
+    std::size_t prg_ram_size{0};
+    std::size_t prg_nvram_size{0};
+    std::size_t chr_ram_size{0};
+    std::size_t chr_nvram_size{0};
+
+    int misc_roms{0};
+    int expansion_device{0};
+};
+
+// Throws bad_rom when it's not an iNES header
+[[nodiscard]] auto parse_ines_header(std::span<const std::uint8_t> header) -> rom_info;
+
+// An iNES or NES 2.0 ROM file mapped into memory. Its ROM image points into the mapping,
+// which stays as long as the image or a cartridge made of it does, so nothing is read
+// or copied before it's used.
+class rom_file
+{
+public:
+    // Throws std::system_error when the file can't be mapped, bad_rom when it's no ROM
+    explicit rom_file(const std::filesystem::path& path);
+
+    // A ROM already in memory, bytes being kept by storage
+    rom_file(std::shared_ptr<const void> storage, std::span<const std::uint8_t> bytes);
+
+    [[nodiscard]] auto info() const noexcept -> const rom_info& { return info_; }
+    [[nodiscard]] auto image() const noexcept -> const std::shared_ptr<const rom_image>& { return image_; }
+    [[nodiscard]] auto trainer() const noexcept -> std::span<const std::uint8_t> { return trainer_; }
+
+    // A new cartridge of the mapper in the header, all sharing the image. Throws bad_rom for
+    // mappers without support and for games that use CHR RAM.
+    [[nodiscard]] auto make_cartridge() const -> std::unique_ptr<cartridge>;
+
+private:
+    void parse(std::shared_ptr<const void> storage, std::span<const std::uint8_t> bytes);
+
+    rom_info info_;
+    std::shared_ptr<const rom_image> image_;
+    std::span<const std::uint8_t> trainer_;
+};
+
+}// namespace nes
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <libnes/literals.hpp>
+#include <libnes/ppu_pattern_table.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace nes
+{
+
+template <std::size_t size>
+using membank = std::array<std::uint8_t, size>;
+
+// PRG and CHR ROM of a game, loaded once and shared read-only by every cartridge made of it,
+// along with its CHR banks decoded. Cartridges only keep which banks they have mapped.
+// Banks are decoded the first time they're asked for, so an image of a mapped file costs
+// nothing until it's played.
+class rom_image
+{
+public:
+    static constexpr auto PRG_BANK_SIZE = 16_Kb;
+    static constexpr auto CHR_BANK_SIZE = 4_Kb;
+
+    // Copies the banks into storage of the image's own
+    rom_image(std::span<const membank<PRG_BANK_SIZE>> prg, std::span<const membank<CHR_BANK_SIZE>> chr)
+        : rom_image{concatenate(prg, chr), prg.size(), chr.size()} {}
+
+    // prg and chr are whole banks in storage, which is kept as long as the image
+    rom_image(std::shared_ptr<const void> storage, std::span<const std::uint8_t> prg, std::span<const std::uint8_t> chr)
+        : storage_{std::move(storage)}
+        , prg_{prg}
+        , chr_{chr}
+        , pattern_tables_(chr_banks())
+        , decoded_(chr_banks()) {
+        if (prg_.empty() or prg_.size() % PRG_BANK_SIZE != 0 or chr_.size() % CHR_BANK_SIZE != 0)
+            throw std::invalid_argument("ROM image of partial banks");
+    }
+
+    [[nodiscard]] auto prg_banks() const noexcept -> std::size_t { return prg_.size() / PRG_BANK_SIZE; }
+    [[nodiscard]] auto chr_banks() const noexcept -> std::size_t { return chr_.size() / CHR_BANK_SIZE; }
+
+    [[nodiscard]] auto prg_bank(std::size_t i) const noexcept -> std::span<const std::uint8_t, PRG_BANK_SIZE> {
+        return prg_.subspan(i * PRG_BANK_SIZE).first<PRG_BANK_SIZE>();
+    }
+
+    [[nodiscard]] auto chr_bank(std::size_t i) const noexcept -> std::span<const std::uint8_t, CHR_BANK_SIZE> {
+        return chr_.subspan(i * CHR_BANK_SIZE).first<CHR_BANK_SIZE>();
+    }
+
+    // Safe to call from many threads, the first one decodes
+    [[nodiscard]] auto pattern_table(std::size_t i) const -> const nes::pattern_table& {
+        std::call_once(decoded_[i], [&] {
+            pattern_tables_[i] = std::make_unique<nes::pattern_table>();
+            pattern_tables_[i]->decode(chr_bank(i));
+        });
+        return *pattern_tables_[i];
+    }
+
+private:
+    rom_image(std::shared_ptr<const std::vector<std::uint8_t>> storage, std::size_t prg_banks, std::size_t chr_banks)
+        : rom_image{storage, std::span{*storage}.first(prg_banks * PRG_BANK_SIZE), std::span{*storage}.subspan(prg_banks * PRG_BANK_SIZE, chr_banks * CHR_BANK_SIZE)} {}
+
+    static auto concatenate(std::span<const membank<PRG_BANK_SIZE>> prg, std::span<const membank<CHR_BANK_SIZE>> chr) -> std::shared_ptr<const std::vector<std::uint8_t>> {
+        auto storage = std::make_shared<std::vector<std::uint8_t>>();
+        storage->reserve(prg.size() * PRG_BANK_SIZE + chr.size() * CHR_BANK_SIZE);
+
+        for (const auto& bank: prg)
+            storage->insert(storage->end(), bank.begin(), bank.end());
+        for (const auto& bank: chr)
+            storage->insert(storage->end(), bank.begin(), bank.end());
+
+        return storage;
+    }
+
+    std::shared_ptr<const void> storage_;
+    std::span<const std::uint8_t> prg_;
+    std::span<const std::uint8_t> chr_;
+    mutable std::vector<std::unique_ptr<nes::pattern_table>> pattern_tables_;
+    mutable std::vector<std::once_flag> decoded_;
+};
+
+}// namespace nes
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace nes
+{
+
+class bad_savestate: public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// A saved state starts with these, a state of another version is refused rather than misread
+constexpr auto SAVESTATE_MAGIC = std::uint32_t{0x5353454E};// "NESS"
+constexpr auto SAVESTATE_VERSION = std::uint16_t{1};
+
+template <class T>
+concept state_field = std::integral<T> or std::is_enum_v<T>;
+
+// Writes fields little endian whatever the host is, into a buffer given up front, so it
+// never allocates. Writing goes on counting past the end of the buffer, which is how
+// writing to an empty one tells the size a state needs.
+class state_writer
+{
+public:
+    explicit constexpr state_writer(std::span<std::uint8_t> buffer = {}) noexcept
+        : buffer_{buffer} {}
+
+    template <state_field T>
+    constexpr void write(T value) noexcept {
+        if constexpr (std::is_enum_v<T>) {
+            write(std::to_underlying(value));
+        } else if constexpr (std::same_as<T, bool>) {
+            write(std::uint8_t{value});
+        } else {
+            const auto bits = static_cast<std::make_unsigned_t<T>>(value);
+            for (auto byte = 0u; byte < sizeof(T); ++byte)
+                put(static_cast<std::uint8_t>(bits >> (8 * byte)));
+        }
+    }
+
+    constexpr void write(std::span<const std::uint8_t> bytes) noexcept {
+        if (size_ + bytes.size() <= buffer_.size())
+            std::ranges::copy(bytes, buffer_.begin() + static_cast<std::ptrdiff_t>(size_));
+        size_ += bytes.size();
+    }
+
+    // Bytes written, or that would have been when the buffer was too small
+    [[nodiscard]] constexpr auto size() const noexcept { return size_; }
+    [[nodiscard]] constexpr auto fits() const noexcept { return size_ <= buffer_.size(); }
+
+private:
+    constexpr void put(std::uint8_t byte) noexcept {
+        if (size_ < buffer_.size())
+            buffer_[size_] = byte;
+        ++size_;
+    }
+
+    std::span<std::uint8_t> buffer_;
+    std::size_t size_{0};
+};
+
+// Reads what state_writer wrote, throws bad_savestate when it runs out of data
+class state_reader
+{
+public:
+    explicit constexpr state_reader(std::span<const std::uint8_t> state) noexcept
+        : state_{state} {}
+
+    template <state_field T>
+    constexpr auto read() -> T {
+        if constexpr (std::is_enum_v<T>) {
+            return static_cast<T>(read<std::underlying_type_t<T>>());
+        } else if constexpr (std::same_as<T, bool>) {
+            return read<std::uint8_t>() != 0;
+        } else {
+            auto bits = std::make_unsigned_t<T>{0};
+            for (auto byte = 0u; byte < sizeof(T); ++byte)
+                bits |= static_cast<std::make_unsigned_t<T>>(take(1)[0]) << (8 * byte);
+            return static_cast<T>(bits);
+        }
+    }
+
+    template <state_field T>
+    constexpr void read(T& value) {
+        value = read<T>();
+    }
+
+    constexpr void read(std::span<std::uint8_t> bytes) {
+        std::ranges::copy(take(bytes.size()), bytes.begin());
+    }
+
+    [[nodiscard]] constexpr auto remaining() const noexcept { return state_.size(); }
+
+private:
+    constexpr auto take(std::size_t size) -> std::span<const std::uint8_t> {
+        if (size > state_.size())
+            throw bad_savestate("saved state is truncated");
+
+        auto bytes = state_.first(size);
+        state_ = state_.subspan(size);
+        return bytes;
+    }
+
+    std::span<const std::uint8_t> state_;
+};
+
+}// namespace nes
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <libnes/color.hpp>
+
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 
 namespace nes
 {
@@ -14,11 +19,60 @@ inline constexpr auto operator==(nes::point a, nes::point b) {
     return a.x == b.x and a.y == b.y;
 }
 
+// Receives the final RGB color of every pixel
 template <class S>
-concept screen = requires(S s, point p, color c) {
+concept rgb_screen = requires(S s, point p, color c) {
     { s.draw_pixel(p, c) };
     { s.width() } -> std::same_as<short>;
     { s.height() } -> std::same_as<short>;
 };
 
+// Receives 6-bit system palette indices and the color emphasis bits of every line,
+// converting to RGB is left to the consumer
+template <class S>
+concept indexed_screen = requires(S s, point p, short y, std::uint8_t index) {
+    { s.draw_index(p, index) };
+    { s.emphasize(y, index) };
+    { s.width() } -> std::same_as<short>;
+    { s.height() } -> std::same_as<short>;
+};
+
+template <class S>
+concept screen = rgb_screen<S> or indexed_screen<S>;
+
+// Shows nothing, for frames that are emulated but never seen
+struct null_screen {
+    [[nodiscard]] constexpr static auto width() -> short { return 256; }
+    [[nodiscard]] constexpr static auto height() -> short { return 240; }
+
+    constexpr void draw_pixel(point, color) noexcept {}
+    constexpr void draw_span(point, std::span<const color>) noexcept {}
+};
+
+// The PPU doesn't compose pixels for these at all, it only works out what the CPU can see
+template <class S>
+concept headless_screen = std::same_as<S, null_screen>;
+
+// Draws a run of pixels of one line, starting at where. Screens can take the whole run at
+// once by providing draw_span(point, span), any other screen gets it a pixel at a time.
+template <rgb_screen screen_t>
+constexpr void draw_span(screen_t& screen, point where, std::span<const color> pixels) {
+    if constexpr (requires { screen.draw_span(where, pixels); }) {
+        screen.draw_span(where, pixels);
+    } else {
+        for (std::size_t i = 0; i < pixels.size(); ++i)
+            screen.draw_pixel({static_cast<short>(where.x + i), where.y}, pixels[i]);
+    }
+}
+
+template <indexed_screen screen_t>
+constexpr void draw_span(screen_t& screen, point where, std::span<const std::uint8_t> indices) {
+    if constexpr (requires { screen.draw_span(where, indices); }) {
+        screen.draw_span(where, indices);
+    } else {
+        for (std::size_t i = 0; i < indices.size(); ++i)
+            screen.draw_index({static_cast<short>(where.x + i), where.y}, indices[i]);
+    }
+}
+
 }
@@ -2,21 +2,26 @@
 #include <libnes/cpu.hpp>
 #include <libnes/literals.hpp>
 #include <libnes/ppu.hpp>
+#include <libnes/rewind_buffer.hpp>
+#include <libnes/rom_file.hpp>
 
 #include <SDL2/SDL.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <deque>
 #include <filesystem>
-#include <fstream>
 #include <memory>
 #include <numeric>
 #include <random>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <unordered_map>
+#include <vector>
 
 #include "icon16.hpp"
 
@@ -48,6 +53,7 @@ public:
     }
 
     [[nodiscard]] auto id() const { return SDL_GetWindowID(window_); }
+    [[nodiscard]] auto visible() const { return (SDL_GetWindowFlags(window_) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED)) == 0; }
     [[nodiscard]] auto quit() const { return quit_; }
 
 protected:
@@ -262,6 +268,13 @@ struct screen {
             return;
         frame_buffer[where.y * width() + where.x] = color;
     }
+
+    void draw_span(nes::point where, std::span<const nes::color> pixels) {
+        if (where.x >= width() or where.y >= height())
+            return;
+        auto count = std::min<std::size_t>(pixels.size(), width() - where.x);
+        std::copy_n(pixels.begin(), count, frame_buffer.begin() + where.y * width() + where.x);
+    }
 };
 
 struct screen_nt {
@@ -275,81 +288,46 @@ struct screen_nt {
             return;
         frame_buffer[where.y * width() + where.x] = color;
     }
-};
-
-auto load_rom(auto filename) -> std::unique_ptr<nes::cartridge> {
-    auto romfile = std::ifstream{filename, std::ifstream::binary};
-    assert(romfile.is_open());
-
-    nes::ines_header header{};
-    romfile.read(reinterpret_cast<char*>(&header), sizeof(header));
-
-    auto mapper_ix = (header.mapper1 >> 4) | (header.mapper2 & 0xF0);
-
-    assert(mapper_ix == 0 or mapper_ix == 1);
-
-    if (mapper_ix == 0) {
-        if (header.prg_rom_chunks > 2)
-            throw std::runtime_error("unsupported mapper, too many PRG sections");
-
-        if (header.chr_rom_chunks > 1)
-            throw std::runtime_error("unsupported mapper, too many CHR sections");
 
-        auto prg = std::vector<std::array<std::uint8_t, 16_Kb>>{};
-
-        for (auto i = 0; i < header.prg_rom_chunks; ++i) {
-            prg.emplace_back();
-            romfile.read(reinterpret_cast<char*>(prg.back().data()), prg.back().size());
-        }
-
-        auto chr0 = nes::membank<4_Kb>{};
-        romfile.read(reinterpret_cast<char*>(chr0.data()), chr0.size());
-
-        auto chr1 = nes::membank<4_Kb>{};
-        romfile.read(reinterpret_cast<char*>(chr1.data()), chr1.size());
-
-        auto mirroring = (header.mapper1 & 0x01)
-            ? nes::name_table_mirroring::vertical
-            : nes::name_table_mirroring::horizontal;
-
-        return std::make_unique<nes::nrom>(prg, chr0, chr1, mirroring);
-    }
-
-    if (mapper_ix == 1) {
-        auto prg = std::vector<std::array<std::uint8_t, 16_Kb>>{};
-
-        for (auto i = 0; i < header.prg_rom_chunks; ++i) {
-            prg.emplace_back();
-            romfile.read(reinterpret_cast<char*>(prg.back().data()), prg.back().size());
-        }
-
-        auto chr = std::vector<nes::membank<4_Kb>>{};
-
-        for (auto i = 0; i < header.chr_rom_chunks * 2; ++i) {
-            chr.emplace_back();
-            romfile.read(reinterpret_cast<char*>(chr.back().data()), chr.back().size());
-        }
-
-        return std::make_unique<nes::mmc1>(prg, chr);
+    void draw_span(nes::point where, std::span<const nes::color> pixels) {
+        if (where.x >= width() or where.y >= height())
+            return;
+        auto count = std::min<std::size_t>(pixels.size(), width() - where.x);
+        std::copy_n(pixels.begin(), count, frame_buffer.begin() + where.y * width() + where.x);
     }
-
-    throw std::runtime_error("Unsupported mapper " + std::to_string(mapper_ix));
-}
+};
 
 static std::random_device rd;
 static std::mt19937 gen(rd());
 
 struct config {
     std::filesystem::path filename;
+    nes::cpu_backend cpu_backend{nes::cpu_backend::blocks};
+    int rewind_every{1};// frames between the snapshots the time machine steps back through
+    int run_ahead{0};   // frames shown ahead of the emulation, 0 to 3
 };
 
+// usage: nemo_sdl <rom> [--interpreter | --compiled] [--rewind-every <frames>] [--run-ahead <frames>]
 auto parse(int argc, char* argv[]) {
     if (argc < 2)
         throw std::runtime_error("No ROM file specified");
 
-    auto filename = std::string{argv[1]};
+    auto result = config{argv[1]};
+
+    for (auto i = 2; i < argc; ++i) {
+        if (std::string_view{argv[i]} == "--interpreter")
+            result.cpu_backend = nes::cpu_backend::interpreter;
+        else if (std::string_view{argv[i]} == "--compiled")
+            result.cpu_backend = nes::cpu_backend::compiled;
+        else if (std::string_view{argv[i]} == "--rewind-every" and i + 1 < argc)
+            result.rewind_every = std::max(1, std::stoi(argv[++i]));
+        else if (std::string_view{argv[i]} == "--run-ahead" and i + 1 < argc)
+            result.run_ahead = std::clamp(std::stoi(argv[++i]), 0, 3);
+        else
+            throw std::runtime_error("Unknown option " + std::string{argv[i]});
+    }
 
-    return config{filename};
+    return result;
 }
 
 int main(int argc, char* argv[]) {
@@ -361,14 +339,26 @@ int main(int argc, char* argv[]) {
     auto nametable_window = sdl::nametable_window("Name Tables");
 
     auto scr = screen{};
+    auto skipped = nes::null_screen{};
     auto snt = screen_nt{};
-    auto console = nes::console{load_rom(config.filename)};
+    auto console = nes::any_console{nes::rom_file{config.filename}.make_cartridge()};
+    console.select_cpu_backend(config.cpu_backend);
     auto chr = std::array{sdl::chr_window("CHR 0"), sdl::chr_window("CHR 1")};
 
     static constexpr auto FPS = 60;
     static constexpr auto DELAY = static_cast<int>(1000.0f / FPS);
+    static constexpr auto FAST_FORWARD = 8;// frames run for each one shown while Tab is held
     std::uint32_t frameStart, frameTime;
 
+    // Up to five minutes of snapshots, a few hundred bytes each
+    static constexpr auto REWIND_CAPACITY = 32_Kb * 1_Kb;
+    static constexpr auto REWIND_SNAPSHOTS = 5 * 60 * FPS;
+    auto rewind = nes::rewind_buffer{REWIND_CAPACITY, REWIND_SNAPSHOTS};
+    auto state = std::vector<std::uint8_t>(console.save_state({}));
+    auto frame = 0;
+    auto snapshot_shown = false;// the last snapshot pushed is where the frame on screen started
+    auto ahead = std::vector<std::uint8_t>(state.size());
+
     frontend.add_window(&window);
     frontend.add_window(&nametable_window);
     frontend.add_window(&chr[0]);
@@ -399,24 +389,68 @@ int main(int argc, char* argv[]) {
             console.controller_input(keys);
         }
 
-        auto [forward, backward] = []() {
+        auto [forward, backward, fast_forward] = []() {
             auto kb_state = SDL_GetKeyboardState(nullptr);
             return std::tuple{
                 kb_state[SDL_SCANCODE_RIGHT] != 0,
-                kb_state[SDL_SCANCODE_LEFT] != 0};
+                kb_state[SDL_SCANCODE_LEFT] != 0,
+                kb_state[SDL_SCANCODE_TAB] != 0};
         }();
 
-        if (time_machine and forward or not time_machine) {
-            console.render_frame(scr);
-            console.render_nametables(snt);
+        // Caps Lock stops time, right steps forward and left back to the previous snapshot.
+        // The newest is skipped when the frame on screen started from it, it would only show
+        // that frame again; when the frame was run ahead or past it, it is the previous one.
+        auto previous = std::span<const std::uint8_t>{};
+        if (time_machine and backward)
+            previous = snapshot_shown ? rewind.pop() : rewind.newest();
+
+        if (not previous.empty()) {
+            console.load_state(previous);
+            snapshot_shown = true;
+        } else if ((time_machine and forward) or not time_machine) {
+            const auto snapshot = frame++ % config.rewind_every == 0;
+            if (snapshot) {
+                console.save_state(state);
+                rewind.push(state);
+            }
+
+            // a frame run ahead or fast forwarded to doesn't start from it
+            snapshot_shown = snapshot and (time_machine or (not fast_forward and config.run_ahead == 0));
+        }
+
+        if ((time_machine and (forward or not previous.empty())) or not time_machine) {
+            for (auto i = 1; fast_forward and not time_machine and i < FAST_FORWARD; ++i)
+                console.render_frame(skipped);
+
+            if (time_machine or config.run_ahead == 0) {
+                console.render_frame(scr);
+            } else {
+                // The frame that follows from the input goes unseen, the one shown is
+                // run_ahead frames later, as if the input had been read that much earlier.
+                // Then they are undone.
+                console.render_frame(skipped);
+                console.save_state(ahead);
+
+                for (auto i = 1; i < config.run_ahead; ++i)
+                    console.render_frame(skipped);
+                console.render_frame(scr);
+
+                console.load_state(ahead);
+            }
+
+            // The debug windows are only drawn while they can be seen
+            if (nametable_window.visible())
+                console.render_nametables(snt);
 
             for (auto i = 0; i < chr.size(); ++i) {
-                chr[i].render(console.display_pattern_table(i));
+                if (chr[i].visible())
+                    chr[i].render(console.display_pattern_table(i));
             }
         }
 
         window.render(scr.frame_buffer);
-        nametable_window.render(snt.frame_buffer);
+        if (nametable_window.visible())
+            nametable_window.render(snt.frame_buffer);
 
         frameTime = SDL_GetTicks() - frameStart;
 
@@ -0,0 +1,43 @@
+#include "counting_new.hpp"
+
+#include <catch2/catch_all.hpp>
+#include <libnes/console.hpp>
+#include <libnes/indexed_frame.hpp>
+
+#include <memory>
+#include <vector>
+
+using namespace nes::literals;
+
+namespace
+{
+
+// JMP $8000 forever
+auto idle_rom() {
+    auto prg = std::vector<nes::membank<16_Kb>>{{}};
+    prg[0][0x0000] = 0x4C;
+    prg[0][0x0001] = 0x00;
+    prg[0][0x0002] = 0x80;
+    prg[0][0x3FFC] = 0x00;
+    prg[0][0x3FFD] = 0x80;
+    return prg;
+}
+
+}// namespace
+
+TEST_CASE("Console heap") {
+    auto frame = nes::indexed_frame{};
+    auto rom = std::make_unique<nes::nrom>(idle_rom(), nes::membank<4_Kb>{}, nes::membank<4_Kb>{}, nes::name_table_mirroring::vertical);
+
+    const auto before = heap_allocated();
+    auto console = std::make_unique<nes::basic_console<nes::nrom>>(std::move(rom));
+    const auto built = heap_allocated() - before;
+
+    console->render_frame(frame);
+    const auto running = heap_allocated() - before;
+
+    // what a console takes up on top of its ROM, reported with -s
+    INFO("heap per console: " << built << " bytes built, " << running << " bytes after a frame");
+    CHECK(built < 16_Kb);
+    CHECK(running < 64_Kb);
+}
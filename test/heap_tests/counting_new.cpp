@@ -0,0 +1,32 @@
+#include "counting_new.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// In a translation unit of their own, so they aren't inlined into code that allocated with
+// them and then taken for a free of what new returned
+
+namespace
+{
+std::atomic<std::size_t> allocated{0};
+}
+
+auto heap_allocated() noexcept -> std::size_t {
+    return allocated.load();
+}
+
+auto operator new(std::size_t size) -> void* {
+    allocated += size;
+    if (auto p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+
+// Bytes allocated with operator new so far, by every thread. Only heap_tests replaces the
+// global operator new, the other tests allocate as usual.
+auto heap_allocated() noexcept -> std::size_t;
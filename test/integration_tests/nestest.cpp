@@ -1,19 +1,37 @@
 #include <catch2/catch_all.hpp>
+#include <array>
 #include <chrono>
 #include <fstream>
 #include <ranges>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <libnes/cpu.hpp>
 #include <libnes/literals.hpp>
+#include <libnes/rom_file.hpp>
 
 using namespace nes::literals;
 
 struct test_bus {
-    void write(std::uint16_t addr, std::uint8_t value) { mem[addr] = value; }
+    void write(std::uint16_t addr, std::uint8_t value) {
+        mem[addr] = value;
+        if (addr >= 0x8000)
+            ++generation;
+    }
     [[nodiscard]] std::uint8_t read(std::uint16_t addr) const { return mem[addr]; }
-    [[nodiscard]] bool nmi() const { return false; }
+
+    // $8000-$FFFF is PRG ROM, for the decoded blocks backend
+    [[nodiscard]] auto code(std::uint16_t addr) const -> std::span<const std::uint8_t> {
+        if (addr < 0x8000)
+            return {};
+        return {mem.data() + addr, 1_Kb - addr % 1_Kb};
+    }
+    [[nodiscard]] auto code_generation() const -> std::uint32_t { return generation; }
 
     std::vector<std::uint8_t>& mem;
+    std::uint32_t generation{0};
 };
 
 class test_cpu: public nes::cpu<test_bus>
@@ -44,12 +62,8 @@ public:
 
 auto load_nestest() {
     auto memory = std::vector<std::uint8_t>(64_Kb, 0);
-    auto romfile = std::ifstream{"rom/nestest.nes", std::ifstream::binary};
-
-    romfile.seekg(16);// header
-
-    auto prg = std::vector<std::uint8_t>(16_Kb, 0);
-    romfile.read(reinterpret_cast<char*>(prg.data()), prg.size());
+    const auto rom = nes::rom_file{"rom/nestest.nes"};
+    const auto prg = rom.image()->prg_bank(0);
 
     std::ranges::copy(prg, memory.begin() + 0x8000);
     std::ranges::copy(prg, memory.begin() + 0xC000);
@@ -89,4 +103,64 @@ TEST_CASE("The ultimate NES CPU test ROM (aka nestest)") {
 
     CHECK((int) m[0x02] == 0x00);
     CHECK((int) m[0x03] == 0x00);
-}
\ No newline at end of file
+}
+
+// Runs the test step cycles at a time, an instruction at a time for 1, so every instruction
+// of the other backends is checked against the interpreter
+auto trace(nes::cpu_backend backend, std::int64_t step = 1) {
+    auto m = load_nestest();
+    auto bus = test_bus{m};
+    auto cpu = test_cpu{bus};
+    cpu.select_backend(backend);
+
+    auto lines = std::vector<std::string>{};
+
+    while (!cpu.is_test_finished() and lines.size() < 100000) {
+        auto line = std::ostringstream{};
+        cpu.print_status(line) << " CYC:" << std::dec << cpu.cycles();
+        lines.push_back(line.str());
+
+        cpu.run(step);
+    }
+
+    CHECK((int) m[0x02] == 0x00);
+    CHECK((int) m[0x03] == 0x00);
+
+    return lines;
+}
+
+TEST_CASE("nestest, decoded blocks and machine code") {
+    SECTION("same trace as the interpreter") {
+        auto reference = trace(nes::cpu_backend::interpreter);
+        auto blocks = trace(nes::cpu_backend::blocks);
+
+        CHECK(reference.size() == blocks.size());
+        CHECK(std::ranges::mismatch(reference, blocks).in1 == reference.end());
+
+        auto compiled = trace(nes::cpu_backend::compiled);
+        CHECK(std::ranges::equal(reference, compiled));
+    }
+
+    SECTION("same trace as the interpreter, many instructions at a time") {
+        auto reference = trace(nes::cpu_backend::interpreter, 50);
+        auto compiled = trace(nes::cpu_backend::compiled, 50);
+
+        CHECK(std::ranges::equal(reference, compiled));
+    }
+
+    SECTION("whole blocks") {
+        auto m = load_nestest();
+        std::ranges::copy(std::array{0x4C, 0x83, 0x19}, m.begin() + 0x1983);// JMP $1983 when done
+
+        auto bus = test_bus{m};
+        auto cpu = test_cpu{bus};
+        cpu.select_backend(GENERATE(nes::cpu_backend::blocks, nes::cpu_backend::compiled));
+
+        for (auto cycles = 0; !cpu.is_test_finished() and cycles < 10000000;)
+            cycles += static_cast<int>(cpu.run(1000));
+
+        CHECK(cpu.is_test_finished());
+        CHECK((int) m[0x02] == 0x00);
+        CHECK((int) m[0x03] == 0x00);
+    }
+}
@@ -29,11 +29,11 @@ struct bus_test {
         nes::name_table_mirroring cart_mirroring{nes::name_table_mirroring::vertical};
         std::unordered_map<std::uint16_t, std::uint8_t> bytes_written;
 
-        [[nodiscard]] auto chr0() const noexcept -> const nes::membank<4_Kb>& override {
+        [[nodiscard]] auto chr0() const noexcept -> std::span<const std::uint8_t, 4_Kb> override {
             return cart_chr;
         }
 
-        [[nodiscard]] auto chr1() const noexcept -> const nes::membank<4_Kb>& override {
+        [[nodiscard]] auto chr1() const noexcept -> std::span<const std::uint8_t, 4_Kb> override {
             return cart_chr;
         }
 
@@ -122,4 +122,110 @@ TEST_CASE_METHOD(bus_test, "Bus - write data") {
         bus.write(0xC000, 0x67);
         CHECK(cartridge.bytes_written.at(0xC000) == 0x67);
     }
-}
\ No newline at end of file
+}
+TEST_CASE_METHOD(bus_test, "Bus - synchronize PPU") {
+    auto syncs = 0;
+    bus.sync = [&syncs] { ++syncs; };
+
+    ppu.bytes_to_read[0x2002] = 0x80;
+
+    SECTION("memory access does not synchronize") {
+        bus.write(0x0011, 0x13);
+        [[maybe_unused]] auto _ = bus.read(0x0011);
+
+        CHECK(syncs == 0);
+    }
+    SECTION("PPU register access synchronizes") {
+        bus.write(0x2005, 0x88);
+        CHECK(syncs == 1);
+
+        [[maybe_unused]] auto _ = bus.read(0x2002);
+        CHECK(syncs == 2);
+    }
+    SECTION("OAM DMA synchronizes") {
+        bus.write(0x4014, 0x02);
+        CHECK(syncs == 1);
+    }
+    SECTION("mapper register write synchronizes") {
+        bus.write(0x8000, 0x80);
+        CHECK(syncs == 1);
+        CHECK(cartridge.bytes_written.at(0x8000) == 0x80);
+    }
+}
+
+TEST_CASE_METHOD(bus_test, "Bus - page tables") {
+    SECTION("RAM mirrors") {
+        bus.write(0x1FFF, 0x42);
+        CHECK(bus.mem[0x07FF] == 0x42);
+        CHECK(bus.read(0x07FF) == 0x42);
+        CHECK(bus.read(0x0FFF) == 0x42);
+    }
+
+    SECTION("unmapped PRG falls back to the I/O handlers") {
+        ppu.bytes_to_read[0x8000] = 0x55;// the bus asks the PPU first
+
+        CHECK(cartridge.prg_pages()[0] == nullptr);
+        CHECK(bus.read(0x8000) == 0x55);
+    }
+
+    SECTION("PRG ROM") {
+        auto prg = std::vector<nes::membank<16_Kb>>{{}, {}};
+        prg[0][0x0000] = 0x11;
+        prg[0][0x3FFF] = 0x22;
+        prg[1][0x0400] = 0x33;
+
+        auto rom = nes::nrom{prg, {}, {}, nes::name_table_mirroring::vertical};
+        bus.load_cartridge(&rom);
+
+        CHECK(bus.read(0x8000) == 0x11);
+        CHECK(bus.read(0xBFFF) == 0x22);
+        CHECK(bus.read(0xC400) == 0x33);
+
+        bus.write(0x8000, 0x00);
+        CHECK(bus.read(0x8000) == 0x11);
+    }
+
+    SECTION("PRG bank switch") {
+        auto prg = std::vector<nes::membank<16_Kb>>{{}, {}, {}};
+        prg[0][0] = 'a';
+        prg[1][0] = 'b';
+        prg[2][0] = 'c';
+
+        auto rom = nes::mmc1{prg, {{}}};
+        bus.load_cartridge(&rom);
+
+        REQUIRE(bus.read(0x8000) == 'a');
+        REQUIRE(bus.read(0xC000) == 'c');
+
+        for (auto bit = 0; bit < 5; ++bit)
+            bus.write(0xE000, static_cast<std::uint8_t>(1 >> bit));
+
+        CHECK(bus.read(0x8000) == 'b');
+        CHECK(bus.read(0xC000) == 'c');
+    }
+
+    SECTION("code generation changes with the PRG mapping alone") {
+        auto rom = nes::mmc1{std::vector<nes::membank<16_Kb>>(3), std::vector<nes::membank<4_Kb>>(4)};
+        bus.load_cartridge(&rom);
+
+        auto write_register = [this](std::uint16_t addr, std::uint8_t value) {
+            for (auto bit = 0; bit < 5; ++bit)
+                bus.write(addr, static_cast<std::uint8_t>(value >> bit));
+        };
+        const auto generation = bus.code_generation();
+
+        write_register(0xA000, 2);// CHR bank
+        write_register(0x8000, 0x0C);// the same PRG mode it starts in
+        CHECK(bus.code_generation() == generation);
+
+        auto saved = std::vector<std::uint8_t>(2_Kb + 64);
+        auto writer = nes::state_writer{saved};
+        bus.save(writer);
+        auto reader = nes::state_reader{std::span{saved}.first(writer.size())};
+        bus.load(reader);
+        CHECK(bus.code_generation() == generation);
+
+        write_register(0xE000, 1);// PRG bank
+        CHECK(bus.code_generation() != generation);
+    }
+}
@@ -0,0 +1,114 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/console_pool.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using namespace nes::literals;
+
+namespace
+{
+
+// Adds the A button read at $4016 to $10 every frame and draws it as the backdrop
+auto counting_rom() {
+    auto prg = std::vector<nes::membank<16_Kb>>{{}};
+    std::ranges::copy(std::array<std::uint8_t, 41>{
+                          0xA9, 0x80,      // LDA #$80
+                          0x8D, 0x00, 0x20,// STA $2000, NMI on
+                          0x4C, 0x05, 0x80,// loop: JMP loop
+                          0xA9, 0x01,      // nmi: LDA #$01
+                          0x8D, 0x16, 0x40,// STA $4016
+                          0xA9, 0x00,      // LDA #$00
+                          0x8D, 0x16, 0x40,// STA $4016
+                          0xAD, 0x16, 0x40,// LDA $4016
+                          0x65, 0x10,      // ADC $10
+                          0x85, 0x10,      // STA $10
+                          0xA2, 0x3F,      // LDX #$3F
+                          0x8E, 0x06, 0x20,// STX $2006
+                          0xA2, 0x00,      // LDX #$00
+                          0x8E, 0x06, 0x20,// STX $2006
+                          0x8D, 0x07, 0x20,// STA $2007
+                          0x40,            // RTI
+                      },
+                      prg[0].begin());
+    std::ranges::copy(std::array<std::uint8_t, 6>{0x08, 0x80, 0x00, 0x80, 0x00, 0x80}, prg[0].begin() + 0x3FFA);
+    return prg;
+}
+
+// KIL, the CPU jams on it
+auto jamming_rom() {
+    auto prg = std::vector<nes::membank<16_Kb>>{{}};
+    prg[0][0x0000] = 0x02;
+    prg[0][0x3FFC] = 0x00;
+    prg[0][0x3FFD] = 0x80;
+    return prg;
+}
+
+auto make_rom() {
+    return std::make_unique<nes::nrom>(counting_rom(), nes::membank<4_Kb>{}, nes::membank<4_Kb>{}, nes::name_table_mirroring::vertical);
+}
+
+}// namespace
+
+TEST_CASE("Console pool") {
+    static constexpr auto CONSOLES = 13;
+    auto threads = GENERATE(1u, 2u, 5u);
+    auto pool = nes::console_pool{threads};
+
+    auto alone = std::vector<nes::any_console>{};
+    auto frame = nes::indexed_frame{};
+
+    for (auto i = 0; i < CONSOLES; ++i) {
+        CHECK(pool.add(make_rom()) == static_cast<std::size_t>(i));
+        alone.emplace_back(make_rom());
+    }
+
+    CHECK(pool.size() == CONSOLES);
+    CHECK(pool.threads() == threads);
+
+    SECTION("runs every console as if it ran alone") {
+        for (auto batch = 0; batch < 4; ++batch) {
+            for (auto i = 0; i < CONSOLES; ++i) {
+                const auto keys = static_cast<std::uint8_t>((i + batch) % 3 == 0 ? 0x80 : 0x00);
+                pool.input(static_cast<std::size_t>(i), keys);
+                alone[i].controller_input(keys);
+                for (auto f = 0; f < 3; ++f)
+                    alone[i].render_frame(frame);
+            }
+
+            pool.run_frames(3);
+        }
+
+        for (auto i = 0; i < CONSOLES; ++i)
+            CHECK(pool.console(static_cast<std::size_t>(i)).save_state() == alone[i].save_state());
+    }
+
+    SECTION("the last frame of a batch goes to the frame of the console") {
+        pool.input(0, 0x80);
+        pool.render(1, false);
+        pool.run_frames(2);
+
+        alone[0].controller_input(0x80);
+        for (auto i = 0; i < 2; ++i)
+            alone[0].render_frame(frame);
+
+        CHECK(frame.index({0, 0}) != 0);
+        CHECK(std::ranges::equal(pool.frame(0).pixels(), frame.pixels()));
+        CHECK(std::ranges::all_of(pool.frame(1).pixels(), [](auto index) { return index == 0; }));
+    }
+
+    SECTION("a console that throws is stopped, the others go on") {
+        const auto jammed = pool.add(std::make_unique<nes::nrom>(jamming_rom(), nes::membank<4_Kb>{}, nes::membank<4_Kb>{}, nes::name_table_mirroring::vertical));
+
+        for (auto batch = 0; batch < 3; ++batch) {
+            pool.run_frames(2);
+            for (auto f = 0; f < 2; ++f)
+                alone[0].render_frame(frame);
+        }
+
+        REQUIRE(pool.failed(jammed) != nullptr);
+        CHECK_THROWS_AS(std::rethrow_exception(pool.failed(jammed)), nes::unsupported_opcode);
+        CHECK(pool.failed(0) == nullptr);
+        CHECK(pool.console(0).save_state() == alone[0].save_state());
+    }
+}
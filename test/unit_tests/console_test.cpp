@@ -0,0 +1,177 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/console.hpp>
+#include <libnes/indexed_frame.hpp>
+
+#include <algorithm>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+using namespace nes::literals;
+
+namespace
+{
+
+// JMP $8000 forever
+auto idle_rom() {
+    auto prg = std::vector<nes::membank<16_Kb>>{{}};
+    prg[0][0x0000] = 0x4C;
+    prg[0][0x0001] = 0x00;
+    prg[0][0x0002] = 0x80;
+    prg[0][0x3FFC] = 0x00;
+    prg[0][0x3FFD] = 0x80;
+    return prg;
+}
+
+struct unknown_mapper: nes::cartridge {
+    nes::membank<4_Kb> chr{};
+    std::vector<nes::membank<16_Kb>> prg = idle_rom();
+
+    [[nodiscard]] auto chr0() const noexcept -> std::span<const std::uint8_t, 4_Kb> override { return chr; }
+    [[nodiscard]] auto chr1() const noexcept -> std::span<const std::uint8_t, 4_Kb> override { return chr; }
+    [[nodiscard]] auto mirroring() const noexcept -> nes::name_table_mirroring override { return nes::name_table_mirroring::vertical; }
+
+    auto write(std::uint16_t, std::uint8_t) -> bool override { return false; }
+
+    [[nodiscard]] auto read(std::uint16_t addr) -> std::optional<std::uint8_t> override {
+        if (addr >= 0x8000)
+            return prg[0][addr & 0x3FFF];
+        return std::nullopt;
+    }
+};
+
+// Keeps writing to RAM, VRAM and the MMC1 PRG bank register, two identical banks
+auto busy_rom() {
+    auto prg = std::vector<nes::membank<16_Kb>>(2);
+    for (auto& bank: prg) {
+        std::ranges::copy(std::array<std::uint8_t, 18>{
+                              0xA9, 0x1E,      // LDA #$1E
+                              0x8D, 0x01, 0x20,// STA $2001
+                              0xE6, 0x10,      // loop: INC $10
+                              0xA5, 0x10,      // LDA $10
+                              0x8D, 0x07, 0x20,// STA $2007
+                              0x8D, 0x00, 0xE0,// STA $E000
+                              0x4C, 0x05, 0x80,// JMP loop
+                          },
+                          bank.begin());
+        bank[0x3FFC] = 0x00;
+        bank[0x3FFD] = 0x80;
+    }
+    return prg;
+}
+
+template <class console_t>
+auto is_instance(nes::any_console& console) {
+    return console.visit([](auto& c) { return std::is_same_v<std::remove_cvref_t<decltype(c)>, console_t>; });
+}
+
+}// namespace
+
+TEST_CASE("Console") {
+    auto frame = nes::indexed_frame{};
+
+    SECTION("NROM console") {
+        auto console = nes::any_console{std::make_unique<nes::nrom>(idle_rom(), nes::membank<4_Kb>{}, nes::membank<4_Kb>{}, nes::name_table_mirroring::vertical)};
+
+        CHECK(is_instance<nes::basic_console<nes::nrom>>(console));
+        console.render_frame(frame);
+    }
+
+    SECTION("MMC1 console") {
+        auto console = nes::any_console{std::make_unique<nes::mmc1>(idle_rom(), std::vector<nes::membank<4_Kb>>{{}, {}})};
+
+        CHECK(is_instance<nes::basic_console<nes::mmc1>>(console));
+        console.render_frame(frame);
+    }
+
+    SECTION("other mappers use virtual dispatch") {
+        auto console = nes::any_console{std::make_unique<unknown_mapper>()};
+
+        CHECK(is_instance<nes::console>(console));
+        console.render_frame(frame);
+        CHECK(console.display_pattern_table(0).size() == 128 * 128);
+    }
+}
+
+TEST_CASE("Console saved state") {
+    auto frame = nes::indexed_frame{};
+    auto run = [&frame](auto& console, int frames) {
+        for (auto i = 0; i < frames; ++i)
+            console.render_frame(frame);
+    };
+
+    auto console = nes::any_console{std::make_unique<nes::mmc1>(busy_rom(), std::vector<nes::membank<4_Kb>>{{}, {}})};
+    run(console, 8);
+    const auto saved = console.save_state();
+
+    SECTION("loading it goes on the same") {
+        run(console, 3);
+        const auto expected = console.save_state();
+        const auto expected_frame = frame;
+
+        console.load_state(saved);
+        CHECK(console.save_state() == saved);
+
+        run(console, 3);
+        CHECK(console.save_state() == expected);
+        CHECK(std::ranges::equal(frame.pixels(), expected_frame.pixels()));
+    }
+
+    SECTION("saving into a buffer") {
+        auto buffer = std::vector<std::uint8_t>(16_Kb);
+
+        CHECK(console.save_state(std::span{buffer}.first(10)) == saved.size());
+        CHECK(console.save_state(buffer) == saved.size());
+        CHECK(std::ranges::equal(std::span{buffer}.first(saved.size()), saved));
+    }
+
+    SECTION("frames run into no screen go on the same") {
+        auto skipped = nes::null_screen{};
+        console.render_frame(skipped);
+        console.render_frame(skipped);
+        const auto expected = console.save_state();
+
+        console.load_state(saved);
+        run(console, 2);
+        CHECK(console.save_state() == expected);
+    }
+
+    SECTION("the same whichever CPU backend ran") {
+        for (auto backend: {nes::cpu_backend::interpreter, nes::cpu_backend::compiled}) {
+            auto other = nes::any_console{std::make_unique<nes::mmc1>(busy_rom(), std::vector<nes::membank<4_Kb>>{{}, {}})};
+            other.select_cpu_backend(backend);
+            run(other, 8);
+            CHECK(other.save_state() == saved);
+        }
+    }
+
+    SECTION("other states are refused") {
+        auto other_version = saved;
+        other_version[4] ^= 0xFF;
+        CHECK_THROWS_AS(console.load_state(other_version), nes::bad_savestate);
+        CHECK_THROWS_AS(console.load_state(std::span{saved}.first(100)), nes::bad_savestate);
+
+        auto other = nes::any_console{std::make_unique<nes::nrom>(idle_rom(), nes::membank<4_Kb>{}, nes::membank<4_Kb>{}, nes::name_table_mirroring::vertical)};
+        CHECK_THROWS_AS(other.load_state(saved), nes::bad_savestate);
+    }
+
+    SECTION("a state with a value out of range leaves the console as it was") {
+        run(console, 3);
+        const auto before = console.save_state();
+
+        // the scan line, loaded after the CPU, RAM and mapper but before the name tables,
+        // palette, OAM and the clocks
+        auto out_of_range = saved;
+        const auto line = out_of_range.size() - 8 - 8 - (256 + 1) - 32 - 4_Kb - 1 - 2 - 2;
+        out_of_range[line] = 0x00;
+        out_of_range[line + 1] = 0x10;
+        CHECK_THROWS_AS(console.load_state(out_of_range), nes::bad_savestate);
+        CHECK(console.save_state() == before);
+
+        auto expected = nes::any_console{std::make_unique<nes::mmc1>(busy_rom(), std::vector<nes::membank<4_Kb>>{{}, {}})};
+        run(expected, 11);
+        run(console, 2);
+        run(expected, 2);
+        CHECK(console.save_state() == expected.save_state());
+    }
+}
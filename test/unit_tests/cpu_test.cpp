@@ -4,6 +4,12 @@
 #include <libnes/literals.hpp>
 
 #include <array>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
 
 using namespace nes::literals;
 
@@ -22,10 +28,7 @@ public:
         void write(std::uint16_t addr, std::uint8_t value) { mem[addr] = value; }
         std::uint8_t read(std::uint16_t addr) const { return mem[addr]; }
 
-        bool nmi() const { return nmi_on; }
-
         std::vector<std::uint8_t>& mem;
-        bool nmi_on{false};
     };
 
     cpu_test()
@@ -48,7 +51,7 @@ public:
     }
 
     void trigger_nmi() {
-        b.nmi_on = true;
+        cpu.signal_nmi(cpu.cycles());
     }
 
     std::vector<std::uint8_t> mem;
@@ -1606,6 +1609,80 @@ TEST_CASE_METHOD(cpu_test, "NMI")
     CHECK(cpu.pc.value() == 0xb000);
 }
 
+TEST_CASE_METHOD(cpu_test, "NMI at a later cycle")
+{
+    load(0xfffa, std::array{0x00, 0xb0});
+    load(0xb000, std::array{0xea}); // NOP
+    load(prgadr, std::array{0xea, 0xea, 0xea}); // NOP NOP NOP
+
+    cpu.signal_nmi(cpu.cycles() + 3);
+
+    cpu.step();
+    CHECK(cpu.pc.value() == 0x8001);
+    cpu.step();
+    CHECK(cpu.pc.value() == 0x8002);
+    cpu.step();
+    CHECK(cpu.pc.value() == 0xb000);
+
+    cpu.step(); // taken once
+    CHECK(cpu.pc.value() == 0xb001);
+}
+
+TEST_CASE_METHOD(cpu_test, "IRQ")
+{
+    load(0xfffe, std::array{0x00, 0xc0});
+    load(prgadr, std::array{0x58, 0xea, 0x78}); // CLI NOP SEI
+
+    SECTION("masked by interrupt disable")
+    {
+        cpu.p.set(nes::cpu_flag::int_disable);
+        cpu.assert_irq(nes::irq_source::mapper, 0);
+
+        cpu.step(); // CLI
+        CHECK(cpu.pc.value() == 0x8001);
+        cpu.step();
+        CHECK(cpu.pc.value() == 0xc000);
+        CHECK(cpu.p.test(nes::cpu_flag::int_disable));
+    }
+
+    SECTION("level stays asserted")
+    {
+        cpu.p.reset(nes::cpu_flag::int_disable);
+        cpu.assert_irq(nes::irq_source::apu_frame_counter, 0);
+
+        cpu.step();
+        CHECK(cpu.pc.value() == 0xc000);
+
+        load(0xc000, std::array{0x58}); // CLI
+        cpu.step();
+        cpu.step();
+        CHECK(cpu.pc.value() == 0xc000);
+    }
+
+    SECTION("released before it was looked at")
+    {
+        cpu.p.reset(nes::cpu_flag::int_disable);
+        cpu.assert_irq(nes::irq_source::mapper, 0);
+        cpu.assert_irq(nes::irq_source::apu_dmc, 0);
+        cpu.release_irq(nes::irq_source::mapper);
+        cpu.release_irq(nes::irq_source::apu_dmc);
+
+        cpu.step();
+        CHECK(cpu.pc.value() == 0x8001);
+    }
+
+    SECTION("NMI first")
+    {
+        load(0xfffa, std::array{0x00, 0xb0});
+        cpu.p.reset(nes::cpu_flag::int_disable);
+        cpu.assert_irq(nes::irq_source::mapper, 0);
+        cpu.signal_nmi(0);
+
+        cpu.step();
+        CHECK(cpu.pc.value() == 0xb000);
+    }
+}
+
 TEST_CASE_METHOD(cpu_test, "Save state")
 {
     SECTION("Save registers")
@@ -1685,4 +1762,566 @@ TEST_CASE_METHOD(cpu_test, "Save state")
         CHECK(cpu.a.value() == 0x55);
         CHECK(cpu.pc.value() == prgadr + 2);
     }
-}
\ No newline at end of file
+    SECTION("Copied as bytes, interrupt in progress")
+    {
+        load(0xfffa, std::array{0x00, 0x90});
+        trigger_nmi();
+        tick(1, false);
+
+        auto bytes = std::array<std::byte, sizeof(nes::cpu_state)>{};
+        const auto saved = cpu.save_state();
+        std::memcpy(bytes.data(), &saved, sizeof(saved));
+
+        tick(7);
+        cpu.pc.assign(prgadr);
+        cpu.s.assign(0xfd);
+
+        auto restored = nes::cpu_state{};
+        std::memcpy(&restored, bytes.data(), sizeof(restored));
+        cpu.load_state(restored);
+
+        CHECK(cpu.cycles() == 1);
+        CHECK(cpu.is_executing());
+
+        tick(7);
+        CHECK(cpu.pc.value() == 0x9000);
+        CHECK(cpu.s.value() == 0xfa);
+        CHECK(cpu.cycles() == 8);
+    }
+}
+TEST_CASE_METHOD(cpu_test, "Run for N cycles")
+{
+    SECTION("Whole instructions")
+    {
+        load(prgadr, std::array{0xa9, 0x55, 0xa2, 0x10, 0xa5, 0x20}); // LDA #$55; LDX #$10; LDA $20
+        load(0x0020, std::array{0x42});
+
+        CHECK(cpu.run(4) == 4);
+        CHECK_FALSE(cpu.is_executing());
+        CHECK(cpu.a.value() == 0x55);
+        CHECK(cpu.x.value() == 0x10);
+
+        CHECK(cpu.run(3) == 3);
+        CHECK(cpu.a.value() == 0x42);
+        CHECK(cpu.cycles() == 7);
+    }
+    SECTION("Budget is exceeded by the last instruction")
+    {
+        load(prgadr, std::array{0xa5, 0x20}); // LDA $20
+        load(0x0020, std::array{0x42});
+
+        CHECK(cpu.run(1) == 3);
+        CHECK_FALSE(cpu.is_executing());
+        CHECK(cpu.a.value() == 0x42);
+        CHECK(cpu.pc.value() == prgadr + 2);
+    }
+    SECTION("Additional cycles are counted")
+    {
+        load(prgadr, std::array{0xa2, 0x01, 0xbd, 0xff, 0x10}); // LDX #$01; LDA $10FF,X
+        load(0x1100, std::array{0x42});
+
+        CHECK(cpu.run(2) == 2);
+        CHECK(cpu.run(1) == 5);
+        CHECK(cpu.a.value() == 0x42);
+    }
+    SECTION("Finish instruction started by tick")
+    {
+        load(prgadr, std::array{0xa5, 0x20}); // LDA $20
+        load(0x0020, std::array{0x42});
+
+        tick(1, false);
+
+        CHECK(cpu.run(1) == 2);
+        CHECK(cpu.a.value() == 0x42);
+        CHECK(cpu.cycles() == 3);
+    }
+    SECTION("Same result as ticking")
+    {
+        load(prgadr, std::array{0xa2, 0x05, 0xca, 0xd0, 0xfd, 0xe8}); // LDX #$05; loop: DEX; BNE loop; INX
+
+        CHECK(cpu.run(2 + 5 * 2 + 4 * 3 + 2 + 2) == 28);
+        CHECK(cpu.x.value() == 0x01);
+        CHECK(cpu.pc.value() == prgadr + 6);
+    }
+}
+
+TEST_CASE("Opcode table")
+{
+    // What the tools read from the table is what the CPU does: each opcode that doesn't jump
+    // or branch takes its base cycles and moves past its operands
+    for (auto opcode = 0; opcode < 0x100; ++opcode) {
+        const auto& info = nes::OPCODES[opcode];
+        if (not info.is_supported() or nes::is_jump(info.operation) or info.mode == nes::addressing::rel)
+            continue;
+
+        auto mem = create_memory();
+        mem[0x8000] = static_cast<std::uint8_t>(opcode);
+        auto bus = cpu_test::test_bus{mem};
+        auto cpu = nes::cpu{bus};
+
+        INFO("opcode " << opcode);
+        CHECK(cpu.step() == info.cycles);
+        CHECK(cpu.pc.value() == 0x8001 + nes::operand_size(info.mode));
+    }
+}
+
+TEST_CASE("Flags register")
+{
+    auto p = nes::flags_register{};
+
+    SECTION("Packs to and from bits")
+    {
+        for (auto bits = 0; bits < 0x100; ++bits) {
+            p.assign(static_cast<std::uint8_t>(bits));
+            CHECK(p.value() == (bits | 0x20));
+        }
+    }
+    SECTION("Zero and negative follow the last result")
+    {
+        p.set_result(0x00);
+        CHECK(p.test(nes::cpu_flag::zero));
+        CHECK_FALSE(p.test(nes::cpu_flag::negative));
+
+        p.set_result(0x80);
+        CHECK_FALSE(p.test(nes::cpu_flag::zero));
+        CHECK(p.test(nes::cpu_flag::negative));
+        CHECK(p.value() == 0xA0);
+    }
+    SECTION("Flags set one at a time")
+    {
+        p.set_result(0x00);
+        p.set(nes::cpu_flag::negative);
+        p.set(nes::cpu_flag::carry);
+        p.set_overflow_bit(0x80);
+        p.set(nes::cpu_flag::decimal);
+        CHECK(p.value() == 0xEB);
+
+        p.reset(nes::cpu_flag::zero);
+        p.reset(nes::cpu_flag::overflow);
+        CHECK(p.value() == 0xA9);
+    }
+}
+
+namespace
+{
+
+// ROM from $8000 in two switchable 32 KB banks, any write there selects the other one
+struct rom_bus
+{
+    void write(std::uint16_t addr, std::uint8_t value)
+    {
+        if (addr >= 0x8000) {
+            bank = (bank + 1) % 2;
+            ++generation;
+        } else {
+            ram[addr] = value;
+        }
+    }
+    std::uint8_t read(std::uint16_t addr) const
+    {
+        if (addr < 0x8000)
+            return ram[addr];
+        ++rom_reads;
+        return banks[bank][addr - 0x8000];
+    }
+
+    auto code(std::uint16_t addr) const -> std::span<const std::uint8_t>
+    {
+        if (addr < 0x8000)
+            return {};
+        return std::span{banks[bank]}.subspan(addr - 0x8000, 1_Kb - addr % 1_Kb);
+    }
+    auto code_generation() const -> std::uint32_t { return generation; }
+
+    std::vector<std::uint8_t> ram = std::vector<std::uint8_t>(32_Kb);
+    std::array<std::vector<std::uint8_t>, 2> banks{std::vector<std::uint8_t>(32_Kb), std::vector<std::uint8_t>(32_Kb)};
+    int bank{0};
+    std::uint32_t generation{0};
+    mutable int rom_reads{0};
+};
+
+}// namespace
+
+TEST_CASE("Block cache")
+{
+    static_assert(nes::code_bus<rom_bus>);
+
+    auto bus = rom_bus{};
+    auto load = [&bus](int bank, std::uint16_t addr, auto program) {
+        std::ranges::copy(program, bus.banks[bank].begin() + addr - 0x8000);
+    };
+    load(0, 0xfffc, std::array{0x00, 0x80});
+    load(1, 0xfffc, std::array{0x00, 0x80});
+
+    SECTION("Same result as stepping")
+    {
+        load(0, 0x8000, std::array{0xa2, 0x05, 0xca, 0xd0, 0xfd, 0xe8}); // LDX #$05; loop: DEX; BNE loop; INX
+
+        auto cpu = nes::cpu{bus};
+        CHECK(cpu.run(2 + 5 * 2 + 4 * 3 + 2 + 2) == 28);
+        CHECK(cpu.x.value() == 0x01);
+        CHECK(cpu.pc.value() == 0x8006);
+    }
+    SECTION("Stops when out of cycles")
+    {
+        load(0, 0x8000, std::array{0xe8, 0xe8, 0xe8, 0xe8}); // INX x4
+
+        auto cpu = nes::cpu{bus};
+        CHECK(cpu.run(3) == 4);
+        CHECK(cpu.x.value() == 0x02);
+        CHECK(cpu.pc.value() == 0x8002);
+    }
+    SECTION("Code in RAM is interpreted")
+    {
+        load(0, 0x8000, std::array{0x4c, 0x00, 0x02}); // JMP $0200
+        std::ranges::copy(std::array{0xe8, 0xe8}, bus.ram.begin() + 0x0200); // INX INX
+
+        auto cpu = nes::cpu{bus};
+        cpu.run(3 + 4);
+        CHECK(cpu.x.value() == 0x02);
+
+        bus.ram[0x0201] = 0xc8; // INY, picked up as it isn't cached
+        cpu.pc.assign(0x0200);
+        cpu.run(4);
+        CHECK(cpu.y.value() == 0x01);
+    }
+    SECTION("Interrupt taken inside a block")
+    {
+        load(0, 0xfffa, std::array{0x00, 0xb0});
+        load(0, 0xb000, std::array{0xea}); // NOP
+        load(0, 0x8000, std::array{0xe8, 0xe8, 0xe8, 0xe8}); // INX x4
+
+        auto cpu = nes::cpu{bus};
+        cpu.signal_nmi(cpu.cycles() + 3);
+        cpu.run(4 + 7);
+
+        CHECK(cpu.x.value() == 0x02);
+        CHECK(cpu.pc.value() == 0xb000);
+    }
+    SECTION("IRQ held while masked")
+    {
+        load(0, 0xfffe, std::array{0x00, 0xb0});
+        load(0, 0xb000, std::array{0xc8, 0x40});                   // IRQ: INY; RTI
+        load(0, 0x8000, std::array{0x78, 0xe8, 0xe0, 0x40, 0xd0, 0xfb, 0x58, 0x4c, 0x07, 0x80}); // SEI; loop: INX; CPX #$40; BNE loop; CLI; JMP *
+
+        auto run = [&bus](nes::cpu_backend backend) {
+            auto cpu = nes::cpu{bus};
+            cpu.select_backend(backend);
+            cpu.run(2);
+            cpu.assert_irq(nes::irq_source::mapper, cpu.cycles());
+
+            bus.rom_reads = 0;
+            cpu.run(0x3f * 7);
+            const auto masked_reads = bus.rom_reads;
+            cpu.run(40);
+
+            return std::pair{masked_reads, std::tuple{cpu.cycles(), cpu.pc.value(), cpu.x.value(), cpu.y.value(), cpu.p.value()}};
+        };
+
+        const auto [interpreted_reads, interpreted] = run(nes::cpu_backend::interpreter);
+        const auto [block_reads, blocks] = run(nes::cpu_backend::blocks);
+
+        CHECK(block_reads < interpreted_reads); // no opcode fetches, the loop ran from blocks
+        CHECK(blocks == interpreted);
+        CHECK(std::get<3>(blocks) != 0); // taken once unmasked
+    }
+    SECTION("Same saved state as the interpreter")
+    {
+        load(0, 0x8000, std::array{0xa2, 0x05, 0xca, 0xd0, 0xfd, 0xe8, 0x4c, 0x00, 0x80}); // LDX #$05; loop: DEX; BNE loop; INX; JMP $8000
+
+        auto saved = [&bus](nes::cpu_backend backend) {
+            auto cpu = nes::cpu{bus};
+            cpu.select_backend(backend);
+            cpu.run(1000);
+
+            const auto state = cpu.save_state();
+            auto bytes = std::array<std::byte, sizeof(state)>{};
+            std::memcpy(bytes.data(), &state, sizeof(state));
+            return bytes;
+        };
+
+        CHECK(saved(nes::cpu_backend::blocks) == saved(nes::cpu_backend::interpreter));
+        CHECK(saved(nes::cpu_backend::compiled) == saved(nes::cpu_backend::interpreter));
+    }
+    SECTION("Bank switch")
+    {
+        load(0, 0x8000, std::array{0x8d, 0x00, 0x80, 0xe8, 0xe8}); // STA $8000; INX; INX
+        load(1, 0x8003, std::array{0xc8, 0xc8});                   // INY; INY
+
+        auto cpu = nes::cpu{bus};
+        CHECK(cpu.run(4 + 2 + 2) == 8);
+        CHECK(cpu.x.value() == 0x00);
+        CHECK(cpu.y.value() == 0x02);
+
+        bus.write(0x8000, 0); // back to the first bank
+        cpu.pc.assign(0x8003);
+        cpu.run(4);
+        CHECK(cpu.x.value() == 0x02);
+    }
+}
+
+namespace
+{
+
+// Compiled from INX INX, but increments Y to tell it apart from the interpreter
+template <class cpu_t>
+void iny_twice(cpu_t& cpu, std::int64_t deadline)
+{
+    cpu.pc.assign(0x8001);
+    cpu.execute(nes::iny, nes::imp, 2);
+    if (cpu.cycles() >= deadline or cpu.is_interrupt_due())
+        return;
+    cpu.pc.assign(0x8002);
+    cpu.execute(nes::iny, nes::imp, 2);
+}
+
+constexpr auto INX_INX = std::array<std::uint8_t, 2>{0xe8, 0xe8};
+
+}// namespace
+
+TEST_CASE("Compiled blocks")
+{
+    using cpu_t = nes::cpu<rom_bus>;
+
+    auto bus = rom_bus{};
+    std::ranges::copy(std::array{0x00, 0x80}, bus.banks[0].begin() + 0x7ffc);
+    std::ranges::copy(INX_INX, bus.banks[0].begin());
+
+    const auto blocks = std::array{nes::compiled_block<cpu_t>{0x8000, INX_INX, &iny_twice<cpu_t>}};
+
+    auto cpu = cpu_t{bus};
+    cpu.load_compiled(blocks);
+    cpu.select_backend(nes::cpu_backend::compiled);
+
+    SECTION("Run where the code matches")
+    {
+        CHECK(cpu.run(4) == 4);
+        CHECK(cpu.y.value() == 0x02);
+        CHECK(cpu.x.value() == 0x00);
+        CHECK(cpu.pc.value() == 0x8002);
+    }
+    SECTION("Return at the deadline")
+    {
+        CHECK(cpu.run(1) == 2);
+        CHECK(cpu.y.value() == 0x01);
+        CHECK(cpu.pc.value() == 0x8001);
+    }
+    SECTION("Not run over other code")
+    {
+        bus.banks[0][1] = 0xc8; // INY
+
+        CHECK(cpu.run(4) == 4);
+        CHECK(cpu.x.value() == 0x01);
+        CHECK(cpu.y.value() == 0x01);
+    }
+    SECTION("Not run by the other backends")
+    {
+        cpu.select_backend(nes::cpu_backend::blocks);
+
+        CHECK(cpu.run(4) == 4);
+        CHECK(cpu.x.value() == 0x02);
+    }
+}
+
+TEST_CASE("Machine code")
+{
+    auto bus = rom_bus{};
+    auto load = [&bus](int bank, std::uint16_t addr, auto program) {
+        std::ranges::copy(program, bus.banks[bank].begin() + addr - 0x8000);
+    };
+    for (auto bank: {0, 1})
+        load(bank, 0xfffa, std::array{0x00, 0xb0, 0x00, 0x80, 0x00, 0xb1});
+    load(0, 0xb000, std::array{0xe6, 0x30, 0x40});                         // NMI: INC $30; RTI
+    load(0, 0xb100, std::array{0xe6, 0x31, 0x68, 0x09, 0x04, 0x48, 0x40}); // IRQ: INC $31; return with I set
+
+    // The state after running for the given cycles, step cycles at a time
+    auto run = [&bus](nes::cpu_backend backend, std::int64_t step, auto interrupts) {
+        std::ranges::fill(bus.ram, 0);
+        bus.bank = 0;
+        bus.rom_reads = 0;
+
+        auto cpu = nes::cpu{bus};
+        cpu.select_backend(backend);
+        interrupts(cpu);
+        for (auto cycles = std::int64_t{0}; cycles < 20000;)
+            cycles += cpu.run(step);
+
+        return std::tuple{cpu.cycles(), cpu.pc.value(), cpu.a.value(), cpu.x.value(), cpu.y.value(), cpu.p.value(), cpu.s.value(), bus.ram};
+    };
+    const auto none = [](auto&) {};
+
+    SECTION("Same result as the interpreter")
+    {
+        load(0, 0x8000, std::array{
+            0xa2, 0x00, 0xa0, 0x00,                   // LDX #0; LDY #0
+            0x8a, 0x18, 0x69, 0x37, 0x38, 0xe9, 0x11, // loop: TXA; CLC; ADC #$37; SEC; SBC #$11
+            0x49, 0x5a, 0x09, 0x01, 0x29, 0xf7,       // EOR #$5A; ORA #$01; AND #$F7
+            0x95, 0x10, 0xc9, 0x80, 0xb0, 0x01, 0xc8, // STA $10,X; CMP #$80; BCS +1; INY
+            0xe0, 0x40, 0xe8, 0x90, 0xe7,             // CPX #$40; INX; BCC loop
+            0x08, 0x68, 0x85, 0x00, 0xb8,             // PHP; PLA; STA $00; CLV
+            0x70, 0x00, 0x50, 0x00, 0x10, 0x02, 0x30, 0x00, 0xf0, 0x00, 0xd0, 0x00, // BVS, BVC, BPL, BMI, BEQ, BNE
+            0xca, 0xba, 0x9a, 0xf8, 0xd8, 0x78, 0x58, // DEX; TSX; TXS; SED; CLD; SEI; CLI
+            0xe6, 0x20, 0x4c, 0x00, 0x80});           // INC $20; JMP $8000
+
+        for (auto step: {1, 7, 100, 20000}) {
+            CAPTURE(step);
+            CHECK(run(nes::cpu_backend::compiled, step, none) == run(nes::cpu_backend::interpreter, step, none));
+        }
+
+        const auto blocks = (run(nes::cpu_backend::blocks, 20000, none), bus.rom_reads);
+        const auto compiled = (run(nes::cpu_backend::compiled, 20000, none), bus.rom_reads);
+        if constexpr (nes::jit_compiler::available)
+            CHECK(compiled < blocks); // immediate operands are part of the machine code
+
+        SECTION("with interrupts")
+        {
+            const auto nmi = [](auto& cpu) { cpu.signal_nmi(5003); };
+            const auto irq = [](auto& cpu) { cpu.assert_irq(nes::irq_source::mapper, 3001); };
+
+            for (auto step: {7, 20000}) {
+                CAPTURE(step);
+                CHECK(run(nes::cpu_backend::compiled, step, nmi) == run(nes::cpu_backend::interpreter, step, nmi));
+                CHECK(run(nes::cpu_backend::compiled, step, irq) == run(nes::cpu_backend::interpreter, step, irq));
+            }
+            CHECK(std::get<7>(run(nes::cpu_backend::compiled, 20000, irq))[0x31] > 1);
+        }
+    }
+    SECTION("Left when the bank is switched")
+    {
+        // INX; TXA; AND #$07; BNE +3; STA $8000; JMP $8000, with INY and TYA in the other bank
+        load(0, 0x8000, std::array{0xe8, 0x8a, 0x29, 0x07, 0xd0, 0x03, 0x8d, 0x00, 0x80, 0x4c, 0x00, 0x80});
+        load(1, 0x8000, std::array{0xc8, 0x98, 0x29, 0x03, 0xd0, 0x03, 0x8d, 0x00, 0x80, 0x4c, 0x00, 0x80});
+
+        CHECK(run(nes::cpu_backend::compiled, 20000, none) == run(nes::cpu_backend::interpreter, 20000, none));
+        CHECK(run(nes::cpu_backend::compiled, 9, none) == run(nes::cpu_backend::interpreter, 9, none));
+    }
+}
+
+namespace
+{
+
+// Reads of $3000 throw from the given one on
+struct throwing_bus: rom_bus
+{
+    std::uint8_t read(std::uint16_t addr)
+    {
+        if (addr == 0x3000 and ++reads >= throw_from)
+            throw std::range_error("not implemented");
+        return rom_bus::read(addr);
+    }
+
+    int reads{0};
+    int throw_from{std::numeric_limits<int>::max()};
+};
+
+}// namespace
+
+TEST_CASE("Machine code throwing")
+{
+    auto bus = throwing_bus{};
+    std::ranges::copy(std::array{0xe8, 0xad, 0x00, 0x30, 0x4c, 0x00, 0x80}, bus.banks[0].begin()); // INX; LDA $3000; JMP $8000
+    std::ranges::copy(std::array{0x00, 0x80}, bus.banks[0].begin() + 0x7ffc);
+
+    // long after the block is translated, the machine code going round it in one go
+    bus.throw_from = 100;
+
+    auto cpu = nes::cpu{bus};
+    cpu.select_backend(nes::cpu_backend::compiled);
+    CHECK_THROWS_AS(cpu.run(10000), std::range_error);
+    CHECK(cpu.x.value() == 100);
+    CHECK(cpu.pc.value() == 0x8004);// past LDA $3000, as the interpreter leaves it
+
+    bus.throw_from = std::numeric_limits<int>::max();
+    cpu.run(3);// and goes on with the next instruction
+    CHECK(cpu.pc.value() == 0x8000);
+}
+
+namespace
+{
+
+// Reads of $2002 keep returning the same for status_window cycles, RAM and ROM forever
+struct polling_bus: rom_bus
+{
+    std::uint8_t read(std::uint16_t addr)
+    {
+        if (addr == 0x2002)
+            ++status_reads;
+        return rom_bus::read(addr);
+    }
+    auto stable_for(std::uint16_t addr) const -> std::int64_t
+    {
+        return addr == 0x2002 ? status_window : std::numeric_limits<std::int64_t>::max();
+    }
+
+    std::int64_t status_window{0};
+    int status_reads{0};
+};
+
+}// namespace
+
+TEST_CASE("Idle loops")
+{
+    static_assert(nes::polled_bus<polling_bus>);
+
+    auto bus = polling_bus{};
+    auto load = [&bus](std::uint16_t addr, auto program) {
+        std::ranges::copy(program, bus.banks[0].begin() + addr - 0x8000);
+    };
+    load(0xfffa, std::array{0x00, 0xb0, 0x00, 0x80});
+    load(0xb000, std::array{0xe6, 0x10, 0x40}); // NMI: INC $10; RTI
+
+    // The state after running for the given cycles, with an NMI at nmi_at if there's one
+    auto run = [&bus](nes::cpu_backend backend, std::int64_t cycles, std::int64_t nmi_at = 0) {
+        std::ranges::fill(bus.ram, 0);
+        bus.status_reads = 0;
+
+        auto cpu = nes::cpu{bus};
+        cpu.select_backend(backend);
+        if (nmi_at != 0)
+            cpu.signal_nmi(nmi_at);
+        cpu.run(cycles);
+
+        return std::tuple{cpu.cycles(), cpu.pc.value(), cpu.a.value(), cpu.x.value(), cpu.p.value()};
+    };
+
+    SECTION("Jump to itself")
+    {
+        load(0x8000, std::array{0x4c, 0x00, 0x80}); // JMP $8000
+
+        CHECK(run(nes::cpu_backend::blocks, 1000) == run(nes::cpu_backend::interpreter, 1000));
+        CHECK(run(nes::cpu_backend::blocks, 1000, 500) == run(nes::cpu_backend::interpreter, 1000, 500));
+    }
+    SECTION("Status polled while it doesn't change")
+    {
+        load(0x8000, std::array{0xad, 0x02, 0x20, 0x10, 0xfb}); // LDA $2002; BPL $8000
+        bus.status_window = 50;
+
+        const auto reference = run(nes::cpu_backend::interpreter, 1000);
+        const auto reference_reads = bus.status_reads;
+
+        CHECK(run(nes::cpu_backend::blocks, 1000) == reference);
+        CHECK(bus.status_reads < reference_reads);
+    }
+    SECTION("Status polled when it may change")
+    {
+        load(0x8000, std::array{0x2c, 0x02, 0x20, 0x50, 0xfb}); // BIT $2002; BVC $8000
+
+        const auto reference = run(nes::cpu_backend::interpreter, 1000);
+        const auto reference_reads = bus.status_reads;
+
+        CHECK(run(nes::cpu_backend::blocks, 1000) == reference);
+        CHECK(bus.status_reads == reference_reads);
+    }
+    SECTION("RAM polled, then changed by an interrupt")
+    {
+        load(0x8000, std::array{0xa5, 0x10, 0xf0, 0xfc}); // LDA $10; BEQ $8000
+
+        CHECK(run(nes::cpu_backend::blocks, 1000, 300) == run(nes::cpu_backend::interpreter, 1000, 300));
+    }
+    SECTION("Loops with an effect are run")
+    {
+        load(0x8000, std::array{0xe8, 0x4c, 0x00, 0x80}); // INX; JMP $8000
+
+        CHECK(run(nes::cpu_backend::blocks, 1000) == run(nes::cpu_backend::interpreter, 1000));
+    }
+}
@@ -0,0 +1,86 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/frame_converter.hpp>
+
+#include <random>
+#include <vector>
+
+TEST_CASE("frame converter") {
+    auto frame = nes::indexed_frame{};
+    auto converter = nes::frame_converter{nes::DEFAULT_COLORS};
+
+    auto argb = std::vector<std::uint32_t>(256 * 240);
+    auto rgb565 = std::vector<std::uint16_t>(256 * 240);
+    auto gray = std::vector<std::uint8_t>(256 * 240);
+
+    SECTION("indexed frame") {
+        frame.draw_index({3, 2}, 0x30);
+        frame.draw_index({255, 239}, 0xFF);
+        frame.emphasize(2, 0xE0 >> 5);
+
+        CHECK(frame.index({3, 2}) == 0x30);
+        CHECK(frame.index({255, 239}) == 0x3F);
+        CHECK(frame.row(2)[3] == 0x30);
+        CHECK(frame.emphasis(2) == 0x07);
+        CHECK(frame.emphasis(3) == 0x00);
+    }
+
+    SECTION("single pixels") {
+        frame.draw_index({0, 0}, 0x30);  // white
+        frame.draw_index({1, 0}, 0x01);  // blue
+        frame.draw_index({255, 239}, 0x16);
+
+        converter.to_argb8888(frame, argb);
+        converter.to_rgb565(frame, rgb565);
+        converter.to_grayscale(frame, gray);
+
+        CHECK(argb[0] == 0xFFFCFCFC);
+        CHECK(argb[1] == 0xFF0000FC);
+        CHECK(argb[2] == nes::DEFAULT_COLORS[0].value());
+        CHECK(argb[256 * 240 - 1] == nes::DEFAULT_COLORS[0x16].value());
+
+        CHECK(rgb565[0] == 0xFFFF);
+        CHECK(rgb565[1] == 0x001F);
+
+        CHECK(gray[0] == 0xFC);
+        CHECK(gray[1] == 0x1C);
+    }
+
+    SECTION("emphasis dims the other channels") {
+        frame.draw_index({0, 1}, 0x30);
+        frame.emphasize(1, 0x01);// red
+
+        converter.to_argb8888(frame, argb);
+
+        CHECK(argb[0] == nes::DEFAULT_COLORS[0].value());
+        CHECK(argb[256] == 0xFFFCBDBD);
+    }
+
+    SECTION("whole frame") {
+        auto rng = std::mt19937{7};
+        auto index = std::uniform_int_distribution<int>{0, 63};
+
+        for (short y = 0; y < 240; ++y) {
+            frame.emphasize(y, static_cast<std::uint8_t>(y == 100 ? 0x06 : 0x00));
+            for (short x = 0; x < 256; ++x)
+                frame.draw_index({x, y}, static_cast<std::uint8_t>(index(rng)));
+        }
+
+        converter.to_argb8888(frame, argb);
+        converter.to_rgb565(frame, rgb565);
+        converter.to_grayscale(frame, gray);
+
+        for (short y = 0; y < 240; ++y) {
+            for (short x = 0; x < 256; ++x) {
+                auto i = y * 256 + x;
+                auto r = argb[i] >> 16 & 0xFF;
+                auto g = argb[i] >> 8 & 0xFF;
+                auto b = argb[i] & 0xFF;
+
+                if (y != 100)
+                    CHECK(argb[i] == nes::DEFAULT_COLORS[frame.index({x, y})].value());
+                CHECK(rgb565[i] == (((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)));
+                CHECK(gray[i] == ((r * 77 + g * 150 + b * 29) >> 8));
+            }
+        }
+    }
+}
@@ -105,4 +105,52 @@ TEST_CASE("Mapper MMC1") {
             CHECK(cartridge.mirroring() == nes::name_table_mirroring::horizontal);
         }
     }
+
+    SECTION("PRG banks") {
+        SECTION("At creation") {
+            CHECK(cartridge.read(0x8000) == 'a');
+            CHECK(cartridge.read(0xC000) == 'b');
+            CHECK(cartridge.prg_pages()[31] != nullptr);
+        }
+
+        SECTION("Switch bank at $8000") {
+            write(cartridge, 0xE000, 1);
+            CHECK(cartridge.read(0x8000) == 'b');
+            CHECK(cartridge.read(0xC000) == 'b');
+        }
+
+        SECTION("Fix first bank, switch bank at $C000") {
+            write(cartridge, 0x8000, 0b01000);
+            CHECK(cartridge.read(0x8000) == 'a');
+            CHECK(cartridge.read(0xC000) == 'a');
+        }
+
+        SECTION("32 KB mode") {
+            write(cartridge, 0x8000, 0b00000);
+            write(cartridge, 0xE000, 1);// low bit ignored
+            CHECK(cartridge.read(0x8000) == 'a');
+            CHECK(cartridge.read(0xC000) == 'b');
+        }
+    }
+
+    SECTION("Pattern tables") {
+        SECTION("At creation") {
+            CHECK(cartridge.pattern_table(0).tile_row(0, 1) == nes::pattern_table::row{});
+            CHECK(cartridge.pattern_table(1).tile_row(0, 1) == nes::pattern_table::row{});
+        }
+
+        SECTION("Switch CHR bank 0") {
+            [[maybe_unused]] const auto& _ = cartridge.pattern_table(0);
+
+            write(cartridge, 0xA000, 1);
+            CHECK(cartridge.pattern_table(0).tile_row(0, 1) == nes::pattern_table::row{0, 1, 1, 1, 1, 0, 0, 1});// 'y'
+        }
+
+        SECTION("Switch CHR bank 1") {
+            [[maybe_unused]] const auto& _ = cartridge.pattern_table(1);
+
+            write(cartridge, 0xC000, 1);
+            CHECK(cartridge.pattern_table(1).tile_row(0, 2) == nes::pattern_table::row{0, 1, 1, 1, 1, 0, 1, 0});// 'z'
+        }
+    }
 }
\ No newline at end of file
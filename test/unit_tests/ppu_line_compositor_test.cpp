@@ -0,0 +1,115 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/ppu_line_compositor.hpp>
+
+#include <random>
+
+TEST_CASE("line compositor") {
+    auto lc = nes::line_compositor{};
+    auto output = nes::line_compositor::line{};
+
+    static constexpr auto SOLID = nes::pattern_table::row{1, 1, 1, 1, 1, 1, 1, 1};
+
+    SECTION("background only") {
+        lc.background[0] = 0x07;
+        lc.background[255] = 0x0D;
+
+        CHECK_FALSE(lc.compose(0, 256, output));
+        CHECK(output[0] == 0x07);
+        CHECK(output[1] == 0x00);
+        CHECK(output[255] == 0x0D);
+    }
+
+    SECTION("sprite in front of background") {
+        lc.background.fill(0x01);
+        lc.draw_sprite(10, SOLID, 2, false, false, false);
+
+        lc.compose(0, 256, output);
+        CHECK(output[9] == 0x01);
+        CHECK(output[10] == 0x19);
+        CHECK(output[17] == 0x19);
+        CHECK(output[18] == 0x01);
+    }
+
+    SECTION("sprite behind background") {
+        lc.background[10] = 0x01;
+        lc.draw_sprite(10, SOLID, 0, false, true, false);
+
+        lc.compose(0, 256, output);
+        CHECK(output[10] == 0x01);
+        CHECK(output[11] == 0x11);
+    }
+
+    SECTION("first sprite wins") {
+        lc.draw_sprite(0, nes::pattern_table::row{0, 2, 0, 0, 0, 0, 0, 0}, 1, false, false, false);
+        lc.draw_sprite(0, nes::pattern_table::row{3, 3, 0, 0, 0, 0, 0, 0}, 2, false, false, false);
+
+        lc.compose(0, 8, output);
+        CHECK(output[0] == 0x1B);
+        CHECK(output[1] == 0x16);
+    }
+
+    SECTION("flipped horizontally") {
+        lc.draw_sprite(0, nes::pattern_table::row{1, 0, 0, 0, 0, 0, 0, 2}, 0, true, false, false);
+
+        lc.compose(0, 8, output);
+        CHECK(output[0] == 0x12);
+        CHECK(output[7] == 0x11);
+    }
+
+    SECTION("clipped at the right edge") {
+        lc.draw_sprite(252, SOLID, 0, false, false, false);
+
+        lc.compose(0, 256, output);
+        CHECK(output[251] == 0x00);
+        CHECK(output[255] == 0x11);
+    }
+
+    SECTION("sprite 0 hit") {
+        lc.draw_sprite(100, SOLID, 0, false, false, true);
+
+        CHECK_FALSE(lc.compose(0, 256, output));
+
+        lc.background[107] = 0x01;
+        CHECK_FALSE(lc.compose(0, 107, output));
+        CHECK(lc.compose(107, 108, output));
+        CHECK(lc.compose(0, 256, output));
+
+        SECTION("not at x=255") {
+            lc.clear_sprites();
+            lc.background.fill(0x01);
+            lc.draw_sprite(248, SOLID, 0, false, false, true);
+
+            CHECK(lc.compose(248, 255, output));
+            CHECK_FALSE(lc.compose(255, 256, output));
+        }
+    }
+
+    SECTION("vector and scalar paths agree") {
+        auto rng = std::mt19937{42};
+        auto byte = std::uniform_int_distribution<int>{0, 255};
+
+        for (auto round = 0; round < 16; ++round) {
+            lc.clear_sprites();
+            for (auto& b: lc.background)
+                b = byte(rng) < 128 ? 0 : static_cast<std::uint8_t>(byte(rng) & 0x0F);
+
+            for (auto i = 0; i < 8; ++i) {
+                auto row = nes::pattern_table::row{};
+                for (auto& p: row)
+                    p = static_cast<std::uint8_t>(byte(rng) & 0x03);
+                lc.draw_sprite(byte(rng), row, static_cast<std::uint8_t>(i & 3), i & 1, i & 2, i == 0);
+            }
+
+            for (auto [from, to]: {std::pair{0, 256}, {3, 250}, {17, 18}, {31, 64}, {100, 131}}) {
+                auto expected = nes::line_compositor::line{};
+                auto expected_hit = false;
+                for (auto x = from; x < to; ++x)
+                    expected_hit |= lc.compose_scalar(x, expected);
+
+                auto actual = nes::line_compositor::line{};
+                CHECK(lc.compose(from, to, actual) == expected_hit);
+                CHECK(actual == expected);
+            }
+        }
+    }
+}
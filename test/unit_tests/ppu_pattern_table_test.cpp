@@ -0,0 +1,38 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/ppu_pattern_table.hpp>
+
+using namespace nes::literals;
+
+TEST_CASE("pattern table") {
+    auto chr = std::array<std::uint8_t, 4_Kb>{};
+    auto pt = nes::pattern_table{};
+
+    SECTION("empty") {
+        pt.decode(chr);
+
+        CHECK(pt.tile_row(0, 0) == nes::pattern_table::row{});
+        CHECK(pt.tile_row(255, 7) == nes::pattern_table::row{});
+    }
+
+    SECTION("bitplanes") {
+        chr[0x10 * 3 + 2 + 0] = 0b1010'0000;// tile 3, row 2, lsb
+        chr[0x10 * 3 + 2 + 8] = 0b1100'0001;// tile 3, row 2, msb
+
+        pt.decode(chr);
+
+        CHECK(pt.tile_row(3, 2) == nes::pattern_table::row{3, 2, 1, 0, 0, 0, 0, 2});
+        CHECK(pt.pixel(3, 7, 2) == 2);
+        CHECK(pt.tile_row(3, 1) == nes::pattern_table::row{});
+    }
+
+    SECTION("decode single row") {
+        pt.decode(chr);
+        chr[0x10 * 255 + 7] = 0x01;
+
+        CHECK(pt.pixel(255, 7, 7) == 0);
+
+        pt.decode_row(chr, 255, 7);
+
+        CHECK(pt.pixel(255, 7, 7) == 1);
+    }
+}
@@ -1,3 +1,4 @@
+#include <libnes/indexed_frame.hpp>
 #include <libnes/literals.hpp>
 #include <libnes/ppu.hpp>
 
@@ -47,12 +48,12 @@ struct test_cartridge: nes::cartridge {
         : cart_chr{std::move(chr)}
         , cart_mirroring{mirroring} {}
 
-    [[nodiscard]] auto chr0() const noexcept -> const nes::membank<4_Kb>& override {
+    [[nodiscard]] auto chr0() const noexcept -> std::span<const std::uint8_t, 4_Kb> override {
         std::copy_n(cart_chr.begin(), 4_Kb, tmp_.begin());
         return tmp_;
     }
 
-    [[nodiscard]] auto chr1() const noexcept -> const nes::membank<4_Kb>& override {
+    [[nodiscard]] auto chr1() const noexcept -> std::span<const std::uint8_t, 4_Kb> override {
         std::copy_n(std::next(cart_chr.begin(), 4_Kb), 4_Kb, tmp_.begin());
         return tmp_;
     }
@@ -317,6 +318,38 @@ TEST_CASE("PPU") {
                 }
             }
 
+            SECTION("whole scanlines at once") {
+                write(0x2006, ppu, 0x20, 0x00);// Nametable
+                write(0x2007, ppu, 99, 42);
+                write(0x2005, ppu, 1, 0);
+
+                CHECK(ppu.run(screen, 242 * 341) == 242 * 341);
+
+                // horizontal scroll is picked up at the end of the first line
+                CHECK(screen.pixels.at(nes::point{0, 0}) == RASPBERRY);
+                CHECK(screen.pixels.at(nes::point{1, 0}) == OLIVE);
+                CHECK(screen.pixels.at(nes::point{2, 0}) == VIOLET);
+                CHECK(screen.pixels.at(nes::point{14, 1}) == RASPBERRY);
+                CHECK(screen.pixels.at(nes::point{255, 239}) == BLACK);
+            }
+
+            SECTION("palette indices") {
+                auto frame = nes::indexed_frame{};
+
+                write(0x2006, ppu, 0x20, 0x00);// Nametable
+                write(0x2007, ppu, 99);
+                write(0x2001, ppu, 0x40);// emphasize green
+
+                CHECK(ppu.run(frame, 242 * 341) == 242 * 341);
+
+                CHECK(frame.index({0, 0}) == 21);
+                CHECK(frame.index({1, 0}) == 8);
+                CHECK(frame.index({2, 0}) == 3);
+                CHECK(frame.index({3, 0}) == 63);
+                CHECK(frame.emphasis(0) == 0x02);
+                CHECK(frame.emphasis(239) == 0x02);
+            }
+
             SECTION("scroll Y") {
                 cartridge.cart_mirroring = nes::name_table_mirroring::horizontal;
 
@@ -392,6 +425,161 @@ TEST_CASE("PPU") {
 
                 CHECK((ppu.status & 0x40) != 0);
             }
+
+            SECTION("sprite 0 hit, not before the pixel is rendered") {
+                sprites[0] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = 128};
+                ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+
+                write(0x2006, ppu, 0x20, 0x10);// Nametable
+                write(0x2007, ppu, 1);
+
+                ppu.run(screen, 1 * 341 + 2 + 128);
+
+                CHECK((ppu.status & 0x40) == 0);
+
+                ppu.run(screen, 1);
+
+                CHECK((ppu.status & 0x40) != 0);
+            }
+
+            SECTION("sprite 0 hit on the same dot without a screen") {
+                auto none = nes::null_screen{};
+                sprites[0] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = 128};
+                sprites[1] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = 124};
+                ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+
+                write(0x2006, ppu, 0x20, 0x10);// Nametable
+                write(0x2007, ppu, 1);
+
+                ppu.run(none, 1 * 341 + 2 + 128);
+
+                CHECK((ppu.status & 0x40) == 0);
+
+                ppu.run(none, 1);
+
+                CHECK((ppu.status & 0x40) != 0);
+            }
+
+            SECTION("no sprite 0 hit on transparent background") {
+                sprites[0] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = 128};
+                ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+
+                ppu.run(screen, 242 * 341);// Wait one frame
+
+                CHECK((ppu.status & 0x40) == 0);
+            }
+
+            SECTION("no sprite 0 hit at x=255") {
+                sprites[0] = nes::sprite{.y = 1, .tile = 1, .attr = 0x00, .x = 255};
+                ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+
+                write(0x2006, ppu, 0x20, 0x1F);// Nametable
+                write(0x2007, ppu, 42);        // opaque pixel at (255, 1)
+
+                ppu.run(screen, 242 * 341);// Wait one frame
+
+                CHECK(screen.pixels.at(nes::point{255, 1}) == CYAN);
+                CHECK((ppu.status & 0x40) == 0);
+            }
+
+            SECTION("sprite behind background") {
+                sprites[1] = nes::sprite{.y = 0, .tile = 1, .attr = 0x20, .x = 0};
+                sprites[2] = nes::sprite{.y = 0, .tile = 1, .attr = 0x20, .x = 8};
+                ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+
+                write(0x2006, ppu, 0x20, 0x00);// Nametable
+                write(0x2007, ppu, 1);
+
+                ppu.run(screen, 242 * 341);// Wait one frame
+
+                CHECK(screen.pixels.at(nes::point{0, 0}) == RASPBERRY);
+                CHECK(screen.pixels.at(nes::point{8, 0}) == CYAN);
+            }
+
+            SECTION("sprite behind background hides sprites after it") {
+                sprites[1] = nes::sprite{.y = 0, .tile = 1, .attr = 0x20, .x = 0};
+                sprites[2] = nes::sprite{.y = 0, .tile = 1, .attr = 0x01, .x = 0};
+                ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+
+                write(0x2006, ppu, 0x20, 0x00);// Nametable
+                write(0x2007, ppu, 1);
+
+                ppu.run(screen, 242 * 341);// Wait one frame
+
+                CHECK(screen.pixels.at(nes::point{0, 0}) == RASPBERRY);
+            }
+
+            SECTION("lower OAM index in front") {
+                sprites[1] = nes::sprite{.y = 0, .tile = 1, .attr = 0x01, .x = 0};
+                sprites[2] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = 0};
+                ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+
+                ppu.run(screen, 242 * 341);// Wait one frame
+
+                CHECK(screen.pixels.at(nes::point{0, 0}) == WHITE);
+            }
+
+            SECTION("8 sprites per line") {
+                for (auto i = 0; i < 8; ++i)
+                    sprites[i] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = static_cast<std::uint8_t>(i * 8)};
+
+                SECTION("all drawn") {
+                    ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+                    ppu.run(screen, 242 * 341);// Wait one frame
+
+                    CHECK(screen.pixels.at(nes::point{56, 0}) == CYAN);
+                    CHECK((ppu.status & 0x20) == 0);
+                }
+                SECTION("9th dropped, overflow set") {
+                    sprites[8] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = 64};
+                    ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+                    ppu.run(screen, 242 * 341);// Wait one frame
+
+                    CHECK(screen.pixels.at(nes::point{56, 0}) == CYAN);
+                    CHECK(screen.pixels.at(nes::point{64, 0}) == BLACK);
+                    CHECK((ppu.status & 0x20) != 0);
+                }
+                SECTION("overflow set without a screen") {
+                    auto none = nes::null_screen{};
+                    sprites[8] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = 64};
+                    ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+                    ppu.run(none, 341);
+
+                    CHECK((ppu.status & 0x20) == 0);
+
+                    ppu.run(none, 1);
+
+                    CHECK((ppu.status & 0x20) != 0);
+                }
+            }
+
+            SECTION("8x16 sprites") {
+                write(0x2000, ppu, 0x20);
+
+                SECTION("bottom half is the next tile") {
+                    sprites[1] = nes::sprite{.y = 0, .tile = 0, .attr = 0x00, .x = 0};
+                    ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+                    ppu.run(screen, 242 * 341);// Wait one frame
+
+                    CHECK(screen.pixels.at(nes::point{0, 0}) == BLACK);
+                    CHECK(screen.pixels.at(nes::point{0, 8}) == CYAN);
+                }
+                SECTION("flip vertically") {
+                    sprites[1] = nes::sprite{.y = 0, .tile = 0, .attr = 0x80, .x = 0};
+                    ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+                    ppu.run(screen, 242 * 341);// Wait one frame
+
+                    CHECK(screen.pixels.at(nes::point{0, 7}) == CYAN);
+                    CHECK(screen.pixels.at(nes::point{0, 8}) == BLACK);
+                }
+                SECTION("odd tile index selects pattern table 1") {
+                    sprites[1] = nes::sprite{.y = 0, .tile = 1, .attr = 0x00, .x = 0};
+                    ppu.dma_write(0x0000, [mempage](auto addr) { return mempage[addr]; });
+                    ppu.run(screen, 242 * 341);// Wait one frame
+
+                    CHECK(screen.pixels.at(nes::point{0, 8}) == BLACK);
+                }
+            }
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/literals.hpp>
+#include <libnes/rewind_buffer.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace nes::literals;
+
+namespace
+{
+
+// A state of 1 KB in which only a few bytes change from one frame to the next
+auto frame_state(int frame) {
+    auto state = std::vector<std::uint8_t>(1024, 0xA5);
+    state[0] = static_cast<std::uint8_t>(frame);
+    state[1] = static_cast<std::uint8_t>(frame >> 8);
+    state[100 + frame % 800] = 0x00;
+    state[1023] = static_cast<std::uint8_t>(frame * 7);
+    return state;
+}
+
+auto push_frames(nes::rewind_buffer& rewind, int from, int to) {
+    for (auto frame = from; frame < to; ++frame)
+        rewind.push(frame_state(frame));
+}
+
+}// namespace
+
+TEST_CASE("Rewind buffer") {
+    SECTION("steps back through every state pushed") {
+        auto rewind = nes::rewind_buffer{64_Kb, 100};
+        push_frames(rewind, 0, 50);
+        CHECK(rewind.size() == 49);
+        CHECK(rewind.bytes_used() < 49 * 32);
+
+        for (auto frame = 48; frame >= 0; --frame)
+            CHECK(std::ranges::equal(rewind.pop(), frame_state(frame)));
+
+        CHECK(rewind.size() == 0);
+        CHECK(rewind.pop().empty());
+    }
+
+    SECTION("nothing to step back to") {
+        auto rewind = nes::rewind_buffer{64_Kb, 100};
+        CHECK(rewind.pop().empty());
+        CHECK(rewind.newest().empty());
+
+        rewind.push(frame_state(0));
+        CHECK(rewind.pop().empty());
+    }
+
+    SECTION("the newest is there without stepping back") {
+        auto rewind = nes::rewind_buffer{64_Kb, 100};
+        push_frames(rewind, 0, 10);
+
+        CHECK(std::ranges::equal(rewind.newest(), frame_state(9)));
+        CHECK(rewind.size() == 9);
+
+        rewind.pop();
+        CHECK(std::ranges::equal(rewind.newest(), frame_state(8)));
+    }
+
+    SECTION("pushing after stepping back goes on from there") {
+        auto rewind = nes::rewind_buffer{64_Kb, 100};
+        push_frames(rewind, 0, 10);
+        rewind.pop();
+        rewind.pop();
+        push_frames(rewind, 100, 103);
+
+        CHECK(std::ranges::equal(rewind.pop(), frame_state(101)));
+        CHECK(std::ranges::equal(rewind.pop(), frame_state(100)));
+        CHECK(std::ranges::equal(rewind.pop(), frame_state(7)));
+    }
+
+    SECTION("the oldest states are dropped when the snapshots run out") {
+        auto rewind = nes::rewind_buffer{64_Kb, 10};
+        push_frames(rewind, 0, 30);
+        CHECK(rewind.size() == 10);
+
+        for (auto frame = 28; frame >= 19; --frame)
+            CHECK(std::ranges::equal(rewind.pop(), frame_state(frame)));
+        CHECK(rewind.pop().empty());
+    }
+
+    SECTION("the oldest states are dropped when the ring is full") {
+        auto rewind = nes::rewind_buffer{100, 1000};
+        push_frames(rewind, 0, 200);
+        CHECK(rewind.size() > 2);
+        CHECK(rewind.size() < 20);
+        CHECK(rewind.bytes_used() <= 100);
+
+        const auto snapshots = static_cast<int>(rewind.size());
+        for (auto frame = 198; frame > 198 - snapshots; --frame)
+            CHECK(std::ranges::equal(rewind.pop(), frame_state(frame)));
+        CHECK(rewind.pop().empty());
+    }
+
+    SECTION("a state of another size starts over") {
+        auto rewind = nes::rewind_buffer{64_Kb, 100};
+        push_frames(rewind, 0, 10);
+        rewind.push(std::vector<std::uint8_t>(16, 1));
+        CHECK(rewind.size() == 0);
+
+        rewind.push(std::vector<std::uint8_t>(16, 2));
+        CHECK(std::ranges::equal(rewind.pop(), std::vector<std::uint8_t>(16, 1)));
+    }
+}
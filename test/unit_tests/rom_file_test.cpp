@@ -0,0 +1,151 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/rom_file.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+using namespace nes::literals;
+
+namespace
+{
+
+// A 16 byte header followed by the ROM it tells of, PRG bytes 'p' and CHR bytes 'c'
+auto make_file(std::vector<std::uint8_t> header, std::size_t prg, std::size_t chr) {
+    header.resize(16);
+    auto bytes = std::make_shared<std::vector<std::uint8_t>>(header);
+    bytes->insert(bytes->end(), prg, 'p');
+    bytes->insert(bytes->end(), chr, 'c');
+    return bytes;
+}
+
+auto load(const std::shared_ptr<std::vector<std::uint8_t>>& bytes) {
+    return nes::rom_file{bytes, std::span<const std::uint8_t>{*bytes}};
+}
+
+}// namespace
+
+TEST_CASE("iNES header") {
+    SECTION("iNES") {
+        const auto info = nes::parse_ines_header(std::vector<std::uint8_t>{'N', 'E', 'S', 0x1A, 8, 0, 0x13, 0x01, 0, 0x01, 0, 0, 0, 0, 0, 0});
+
+        CHECK_FALSE(info.nes2);
+        CHECK(info.mapper == 1);
+        CHECK(info.console == nes::console_type::vs_system);
+        CHECK(info.region == nes::tv_region::pal);
+        CHECK(info.mirroring == nes::name_table_mirroring::vertical);
+        CHECK(info.battery);
+        CHECK_FALSE(info.trainer);
+        CHECK(info.prg_rom_size == 128_Kb);
+        CHECK(info.chr_rom_size == 0);
+        CHECK(info.chr_ram_size == 8_Kb);
+        CHECK(info.prg_ram_size == 0);
+        CHECK(info.prg_nvram_size == 8_Kb);
+    }
+
+    SECTION("iNES with junk at the end leaves out byte 7") {
+        const auto info = nes::parse_ines_header(std::vector<std::uint8_t>{'N', 'E', 'S', 0x1A, 2, 1, 0x10, 'D', 'i', 's', 'k', 'D', 'u', 'd', 'e', '!'});
+
+        CHECK(info.mapper == 1);
+        CHECK(info.console == nes::console_type::nes);
+        CHECK(info.region == nes::tv_region::ntsc);
+        CHECK(info.prg_ram_size == 8_Kb);
+    }
+
+    SECTION("NES 2.0") {
+        const auto info = nes::parse_ines_header(std::vector<std::uint8_t>{'N', 'E', 'S', 0x1A, 0x02, 0x01, 0x4E, 0x18, 0x21, 0x10, 0x70, 0x07, 0x03, 0, 0x01, 0x2A});
+
+        CHECK(info.nes2);
+        CHECK(info.mapper == 0x114);
+        CHECK(info.submapper == 2);
+        CHECK(info.region == nes::tv_region::dendy);
+        CHECK(info.battery);
+        CHECK(info.trainer);
+        CHECK(info.four_screen);
+        CHECK(info.prg_rom_size == 2 * 16_Kb);
+        CHECK(info.chr_rom_size == 257 * 8_Kb);
+        CHECK(info.prg_ram_size == 0);
+        CHECK(info.prg_nvram_size == 8_Kb);
+        CHECK(info.chr_ram_size == 8_Kb);
+        CHECK(info.chr_nvram_size == 0);
+        CHECK(info.misc_roms == 1);
+        CHECK(info.expansion_device == 0x2A);
+    }
+
+    SECTION("NES 2.0 sizes as exponent and multiplier") {
+        const auto info = nes::parse_ines_header(std::vector<std::uint8_t>{'N', 'E', 'S', 0x1A, (14 << 2) | 1, 13 << 2, 0, 0x08, 0, 0xFF, 0, 0, 0, 0, 0, 0});
+
+        CHECK(info.prg_rom_size == 3 * 16_Kb);
+        CHECK(info.chr_rom_size == 8_Kb);
+    }
+
+    SECTION("of something else") {
+        CHECK_THROWS_AS(nes::parse_ines_header(std::vector<std::uint8_t>{'N', 'E', 'S', 0x1A, 1}), nes::bad_rom);
+        CHECK_THROWS_AS(nes::parse_ines_header(std::vector<std::uint8_t>(16, 0)), nes::bad_rom);
+    }
+}
+
+TEST_CASE("ROM file") {
+    SECTION("banks point into the file") {
+        const auto bytes = make_file({'N', 'E', 'S', 0x1A, 2, 1, 0x01}, 32_Kb, 8_Kb);
+        const auto rom = load(bytes);
+
+        CHECK(rom.image()->prg_banks() == 2);
+        CHECK(rom.image()->chr_banks() == 2);
+        CHECK(rom.image()->prg_bank(0).data() == bytes->data() + 16);
+        CHECK(rom.image()->chr_bank(0).data() == bytes->data() + 16 + 32_Kb);
+        CHECK(rom.trainer().empty());
+
+        const auto cartridge = rom.make_cartridge();
+        CHECK(cartridge->mirroring() == nes::name_table_mirroring::vertical);
+        CHECK(cartridge->chr1()[0] == 'c');
+    }
+
+    SECTION("with a trainer") {
+        auto bytes = make_file({'N', 'E', 'S', 0x1A, 1, 1, 0x04}, 512 + 16_Kb, 8_Kb);
+        (*bytes)[16] = 't';
+        const auto rom = load(bytes);
+
+        CHECK(rom.trainer().size() == 512);
+        CHECK(rom.trainer()[0] == 't');
+        CHECK(rom.image()->prg_bank(0).data() == bytes->data() + 16 + 512);
+    }
+
+    SECTION("without CHR ROM") {
+        const auto rom = load(make_file({'N', 'E', 'S', 0x1A, 1, 0, 0x10}, 16_Kb, 0));
+
+        CHECK(rom.info().chr_ram_size == 8_Kb);
+        CHECK(rom.image()->chr_banks() == 0);
+        CHECK_THROWS_AS(rom.make_cartridge(), nes::bad_rom);
+    }
+
+    SECTION("truncated") {
+        CHECK_THROWS_AS(load(make_file({'N', 'E', 'S', 0x1A, 2, 1}, 32_Kb, 4_Kb)), nes::bad_rom);
+        CHECK_THROWS_AS(load(make_file({'N', 'E', 'S', 0x1A, 0, 1}, 0, 8_Kb)), nes::bad_rom);
+    }
+
+    SECTION("of a mapper without support") {
+        const auto rom = load(make_file({'N', 'E', 'S', 0x1A, 1, 1, 0x40}, 16_Kb, 8_Kb));
+
+        CHECK(rom.info().mapper == 4);
+        CHECK_THROWS_AS(rom.make_cartridge(), nes::bad_rom);
+    }
+
+    SECTION("mapped from disk") {
+        const auto path = std::filesystem::temp_directory_path() / "rom_file_test.nes";
+        const auto bytes = make_file({'N', 'E', 'S', 0x1A, 1, 1}, 16_Kb, 8_Kb);
+        std::ofstream{path, std::ofstream::binary}.write(reinterpret_cast<const char*>(bytes->data()), static_cast<std::streamsize>(bytes->size()));
+
+        auto image = nes::rom_file{path}.image();
+        std::filesystem::remove(path);
+
+        CHECK(image->prg_bank(0)[16_Kb - 1] == 'p');
+        CHECK(image->chr_bank(1)[0] == 'c');
+    }
+
+    SECTION("that isn't there") {
+        CHECK_THROWS_AS(nes::rom_file{std::filesystem::path{"no such rom.nes"}}, std::system_error);
+    }
+}
@@ -0,0 +1,58 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/mappers/mmc1.hpp>
+#include <libnes/mappers/nrom.hpp>
+#include <libnes/rom_image.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace nes::literals;
+
+TEST_CASE("ROM image") {
+    auto prg = std::vector<nes::membank<16_Kb>>(2);
+    auto chr = std::vector<nes::membank<4_Kb>>(4);
+    prg[1][0] = 'b';
+    chr[2][1] = 0x80;// top left pixel of the second row of tile 0
+
+    const auto rom = std::make_shared<const nes::rom_image>(prg, chr);
+
+    SECTION("banks") {
+        CHECK(rom->prg_banks() == 2);
+        CHECK(rom->chr_banks() == 4);
+        CHECK(rom->prg_bank(1)[0] == 'b');
+        CHECK(rom->chr_bank(2)[1] == 0x80);
+        CHECK(rom->pattern_table(2).pixel(0, 0, 1) == 1);
+    }
+
+    SECTION("in storage kept alive by the image") {
+        auto storage = std::make_shared<std::vector<std::uint8_t>>(16_Kb + 8_Kb, std::uint8_t{'s'});
+        const auto bytes = std::span<const std::uint8_t>{*storage};
+        const auto image = nes::rom_image{std::move(storage), bytes.first(16_Kb), bytes.subspan(16_Kb)};
+
+        CHECK(image.prg_bank(0).data() == bytes.data());
+        CHECK(image.chr_banks() == 2);
+        CHECK(image.chr_bank(1)[4_Kb - 1] == 's');
+    }
+
+    SECTION("of partial banks") {
+        auto storage = std::make_shared<std::vector<std::uint8_t>>(16_Kb + 100);
+        const auto bytes = std::span<const std::uint8_t>{*storage};
+
+        CHECK_THROWS_AS((nes::rom_image{storage, bytes.first(16_Kb), bytes.subspan(16_Kb)}), std::invalid_argument);
+        CHECK_THROWS_AS((nes::rom_image{storage, bytes.first(0), {}}), std::invalid_argument);
+    }
+
+    SECTION("shared by cartridges") {
+        auto a = nes::mmc1{rom};
+        auto b = nes::mmc1{rom};
+        auto c = nes::nrom{rom, nes::name_table_mirroring::vertical};
+
+        CHECK(a.prg_pages()[0] == rom->prg_bank(0).data());
+        CHECK(b.prg_pages()[0] == rom->prg_bank(0).data());
+        CHECK(a.chr0().data() == c.chr0().data());
+        CHECK(&a.pattern_table(0) == &rom->pattern_table(0));
+        CHECK(&b.pattern_table(1) == &rom->pattern_table(0));
+        CHECK(&c.pattern_table(1) == &rom->pattern_table(1));
+    }
+}
@@ -0,0 +1,64 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/savestate.hpp>
+
+#include <array>
+#include <cstdint>
+
+namespace
+{
+
+enum class test_enum : std::uint8_t {
+    first,
+    second,
+};
+
+}// namespace
+
+TEST_CASE("Saved state fields") {
+    auto buffer = std::array<std::uint8_t, 16>{};
+
+    SECTION("little endian") {
+        auto writer = nes::state_writer{buffer};
+        writer.write(std::uint16_t{0x1234});
+        writer.write(std::int32_t{-2});
+        writer.write(true);
+        writer.write(test_enum::second);
+
+        CHECK(writer.size() == 8);
+        CHECK(writer.fits());
+        CHECK(buffer == std::array<std::uint8_t, 16>{0x34, 0x12, 0xFE, 0xFF, 0xFF, 0xFF, 0x01, 0x01});
+
+        auto reader = nes::state_reader{buffer};
+        CHECK(reader.read<std::uint16_t>() == 0x1234);
+        CHECK(reader.read<std::int32_t>() == -2);
+        CHECK(reader.read<bool>());
+        CHECK(reader.read<test_enum>() == test_enum::second);
+        CHECK(reader.remaining() == 8);
+    }
+
+    SECTION("bytes") {
+        auto writer = nes::state_writer{buffer};
+        writer.write(std::array<std::uint8_t, 3>{1, 2, 3});
+
+        auto bytes = std::array<std::uint8_t, 3>{};
+        auto reader = nes::state_reader{buffer};
+        reader.read(bytes);
+        CHECK(bytes == std::array<std::uint8_t, 3>{1, 2, 3});
+    }
+
+    SECTION("counting past the end of the buffer") {
+        auto writer = nes::state_writer{std::span{buffer}.first(2)};
+        writer.write(std::uint64_t{0x0102030405060708});
+        writer.write(std::array<std::uint8_t, 3>{1, 2, 3});
+
+        CHECK(writer.size() == 11);
+        CHECK_FALSE(writer.fits());
+        CHECK(buffer[0] == 0x08);
+        CHECK(buffer[2] == 0x00);
+    }
+
+    SECTION("truncated") {
+        auto reader = nes::state_reader{std::span{buffer}.first(3)};
+        CHECK_THROWS_AS(reader.read<std::uint32_t>(), nes::bad_savestate);
+    }
+}
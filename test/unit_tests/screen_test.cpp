@@ -0,0 +1,103 @@
+#include <catch2/catch_all.hpp>
+#include <libnes/indexed_frame.hpp>
+#include <libnes/literals.hpp>
+#include <libnes/mappers/nrom.hpp>
+#include <libnes/ppu.hpp>
+#include <libnes/screen.hpp>
+
+#include <vector>
+
+using namespace nes::literals;
+
+namespace
+{
+
+struct pixel_screen {
+    std::vector<nes::color> pixels = std::vector<nes::color>(256 * 240);
+    int calls{0};
+
+    [[nodiscard]] constexpr static auto width() -> short { return 256; }
+    [[nodiscard]] constexpr static auto height() -> short { return 240; }
+
+    void draw_pixel(nes::point where, nes::color color) {
+        pixels[where.y * width() + where.x] = color;
+        ++calls;
+    }
+};
+
+struct span_screen: pixel_screen {
+    int span_calls{0};
+
+    void draw_span(nes::point where, std::span<const nes::color> colors) {
+        std::ranges::copy(colors, pixels.begin() + where.y * width() + where.x);
+        ++span_calls;
+    }
+};
+
+struct index_screen {
+    std::vector<std::uint8_t> indices = std::vector<std::uint8_t>(256 * 240);
+    int calls{0};
+
+    [[nodiscard]] constexpr static auto width() -> short { return 256; }
+    [[nodiscard]] constexpr static auto height() -> short { return 240; }
+
+    void draw_index(nes::point where, std::uint8_t index) {
+        indices[where.y * width() + where.x] = index;
+        ++calls;
+    }
+    void emphasize(short, std::uint8_t) {}
+};
+
+}// namespace
+
+TEST_CASE("screen") {
+    const auto colors = std::array{nes::DEFAULT_COLORS[1], nes::DEFAULT_COLORS[2], nes::DEFAULT_COLORS[3]};
+
+    SECTION("span drawn a pixel at a time") {
+        auto screen = pixel_screen{};
+        nes::draw_span(screen, {10, 2}, colors);
+
+        CHECK(screen.calls == 3);
+        CHECK(screen.pixels[2 * 256 + 10] == colors[0]);
+        CHECK(screen.pixels[2 * 256 + 12] == colors[2]);
+    }
+
+    SECTION("span drawn at once") {
+        auto screen = span_screen{};
+        nes::draw_span(screen, {10, 2}, colors);
+
+        CHECK(screen.calls == 0);
+        CHECK(screen.span_calls == 1);
+        CHECK(screen.pixels[2 * 256 + 11] == colors[1]);
+    }
+
+    SECTION("indices drawn a pixel at a time") {
+        auto screen = index_screen{};
+        const auto indices = std::array<std::uint8_t, 2>{0x21, 0x22};
+        nes::draw_span(screen, {254, 239}, indices);
+
+        CHECK(screen.calls == 2);
+        CHECK(screen.indices[239 * 256 + 255] == 0x22);
+    }
+
+    SECTION("indices drawn at once") {
+        auto frame = nes::indexed_frame{};
+        const auto indices = std::array<std::uint8_t, 2>{0x21, 0xE2};
+        nes::draw_span(frame, {0, 5}, indices);
+
+        CHECK(frame.index({0, 5}) == 0x21);
+        CHECK(frame.index({1, 5}) == 0x22);
+    }
+
+    SECTION("PPU draws whole lines") {
+        auto ppu = nes::ppu{nes::DEFAULT_COLORS};
+        auto cartridge = nes::nrom{{std::array<std::uint8_t, 16_Kb>{}}, {}, {}, nes::name_table_mirroring::vertical};
+        ppu.load_cartridge(&cartridge);
+
+        auto screen = span_screen{};
+        ppu.run(screen, 242 * 341);
+
+        CHECK(screen.calls == 0);
+        CHECK(screen.span_calls == 240);
+    }
+}
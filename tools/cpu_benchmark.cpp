@@ -0,0 +1,88 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <libnes/cpu.hpp>
+#include <libnes/literals.hpp>
+#include <libnes/rom_file.hpp>
+
+using namespace nes::literals;
+
+// Runs the nestest automation mode (entry point $C000) over and over and
+// reports how many instructions per second the interpreter manages.
+// usage: cpu_benchmark <path to nestest.nes> [iterations]
+
+auto load_rom(const char* filename) {
+    auto memory = std::vector<std::uint8_t>(64_Kb, 0);
+    const auto rom = nes::rom_file{filename};
+    const auto prg = rom.image()->prg_bank(0);
+
+    std::ranges::copy(prg, memory.begin() + 0x8000);
+    std::ranges::copy(prg, memory.begin() + 0xC000);
+
+    return memory;
+}
+
+struct flat_bus {
+    void write(std::uint16_t addr, std::uint8_t value) { mem[addr] = value; }
+    [[nodiscard]] std::uint8_t read(std::uint16_t addr) const { return mem[addr]; }
+
+    std::vector<std::uint8_t> mem;
+};
+
+int main(int argc, char* argv[]) {
+    try {
+        if (argc < 2)
+            throw std::runtime_error("No ROM file specified");
+
+        const auto rom = load_rom(argv[1]);
+        const auto iterations = argc > 2 ? std::stoi(argv[2]) : 500;
+
+        auto bus = flat_bus{rom};
+        auto cpu = nes::cpu{bus};
+
+        auto benchmark = [&](const char* mode, auto execute) {
+            auto instructions = std::int64_t{0};
+            auto cycles = std::int64_t{0};
+
+            auto start = std::chrono::steady_clock::now();
+
+            for (auto i = 0; i < iterations; ++i) {
+                bus.mem = rom;
+                cpu.pc.assign(0xC000);
+                cpu.s.assign(0xFD);
+                cpu.p.assign(0x24);
+
+                while (cpu.pc.value() != 0xC66E) {
+                    cycles += execute();
+                    ++instructions;
+                }
+            }
+
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << mode << ": "
+                      << instructions << " instructions, " << cycles << " cycles in " << elapsed << " s, "
+                      << static_cast<std::int64_t>(instructions / elapsed) << " instructions/s, "
+                      << static_cast<std::int64_t>(cycles / elapsed) << " cycles/s\n";
+        };
+
+        benchmark("tick", [&cpu] {
+            auto cycles = 0;
+            do {
+                cpu.tick();
+                ++cycles;
+            } while (cpu.is_executing());
+            return cycles;
+        });
+
+        benchmark("step", [&cpu] { return cpu.step(); });
+    }
+    catch (const std::exception& ex) {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+}
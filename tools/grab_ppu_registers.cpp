@@ -2,25 +2,21 @@
 #include <vector>
 #include <ranges>
 #include <string_view>
-#include <fstream>
 #include <algorithm>
 #include <iomanip>
 #include <string>
 
 #include <libnes/cpu.hpp>
 #include <libnes/literals.hpp>
+#include <libnes/rom_file.hpp>
 
 using namespace std::string_literals;
 using namespace nes::literals;
 
-auto load_rom(auto filename) {
+auto load_rom(const char* filename) {
     auto memory = std::vector<std::uint8_t>(64_Kb, 0);
-    auto romfile = std::ifstream{filename, std::ifstream::binary};
-
-    romfile.seekg(16); // header
-
-    auto prg = std::vector<std::uint8_t>(16_Kb, 0);
-    romfile.read(reinterpret_cast<char*>(prg.data()), prg.size());
+    const auto rom = nes::rom_file{filename};
+    const auto prg = rom.image()->prg_bank(0);
 
     std::ranges::copy(prg, memory.begin() + 0x8000);
     std::ranges::copy(prg, memory.begin() + 0xC000);
@@ -32,8 +28,6 @@ struct grabbr {
 
     enum class access_type { read, write };
 
-    auto nmi() const { return false; }
-
     void write(std::uint16_t addr, std::uint8_t value) {
         on_access(access_type::write, addr, value);
         mem[addr] = value;
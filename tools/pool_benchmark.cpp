@@ -0,0 +1,56 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <libnes/console_pool.hpp>
+#include <libnes/rom_file.hpp>
+
+// Runs many consoles of one NROM or MMC1 game in a console_pool with 1, 2, 4... up to 64
+// threads and reports how many frames per second they manage together. The consoles share
+// the ROM file mapped once.
+// usage: pool_benchmark <rom> [consoles] [batches] [frames per batch]
+
+int main(int argc, char* argv[]) {
+    try {
+        if (argc < 2)
+            throw std::runtime_error("No ROM file specified");
+
+        const auto game = nes::rom_file{argv[1]};
+        const auto consoles = argc > 2 ? std::stoi(argv[2]) : 256;
+        const auto batches = argc > 3 ? std::stoi(argv[3]) : 10;
+        const auto frames = argc > 4 ? std::stoi(argv[4]) : 6;
+
+        std::cout << consoles << " consoles, " << std::thread::hardware_concurrency() << " hardware threads\n";
+
+        for (auto threads = 1u; threads <= 64; threads *= 2) {
+            auto pool = nes::console_pool{threads};
+            for (auto i = 0; i < consoles; ++i) {
+                pool.add(game.make_cartridge());
+                pool.render(static_cast<std::size_t>(i), false);
+            }
+
+            pool.run_frames(1);// warm up
+
+            auto start = std::chrono::steady_clock::now();
+
+            for (auto batch = 0; batch < batches; ++batch) {
+                for (auto i = 0; i < consoles; ++i)
+                    pool.input(static_cast<std::size_t>(i), static_cast<std::uint8_t>((batch + i) % 2 ? 0x10 : 0x00));
+                pool.run_frames(frames);
+            }
+
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            auto total = static_cast<double>(consoles) * batches * frames;
+
+            std::cout << threads << " threads: "
+                      << total << " frames in " << elapsed << " s, "
+                      << static_cast<std::int64_t>(total / elapsed) << " frames/s\n";
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <libnes/cpu_opcodes.hpp>
+#include <libnes/literals.hpp>
+#include <libnes/rom_file.hpp>
+
+using namespace nes::literals;
+
+// Translates the code reachable from the reset, NMI and IRQ vectors of a ROM into C++
+// calling the operations of cpu_operations.hpp with constant operands, for the compiled
+// CPU backend. Indirect jumps, returns and code in RAM go back to the emulated CPU, which
+// picks up the next block or interprets.
+// usage: recompile <rom.nes> <output.hpp> <namespace> [entry point address in hex...]
+
+namespace
+{
+
+using mode = nes::addressing;
+
+auto hex(unsigned value, int digits) {
+    auto s = std::ostringstream{};
+    s << "0x" << std::hex << std::uppercase << std::setw(digits) << std::setfill('0') << value;
+    return s.str();
+}
+
+// A 16 KB PRG bank as it can appear at base
+struct view {
+    int bank;
+    std::uint16_t base;
+
+    auto operator<=>(const view&) const = default;
+};
+
+class rom
+{
+public:
+    explicit rom(const std::string& filename) {
+        const auto file = nes::rom_file{filename};
+
+        mapper_ = file.info().mapper;
+        if (mapper_ != 0 and mapper_ != 1)
+            throw std::runtime_error("Unsupported mapper " + std::to_string(mapper_));
+
+        image_ = file.image();
+    }
+
+    [[nodiscard]] auto banks() const { return static_cast<int>(image_->prg_banks()); }
+
+    [[nodiscard]] auto read(view v, std::uint16_t addr) const { return image_->prg_bank(static_cast<std::size_t>(v.bank))[addr - v.base]; }
+
+    // NROM maps its first bank at $8000 and the last one at $C000. MMC1 can have any bank at
+    // either, depending on the PRG mode in its control register: the 32 KB mode maps an even
+    // bank at $8000 and the odd one after it at $C000, the other two fix the first bank at
+    // $8000 or the last one at $C000 and switch the other half. Blocks only run where their
+    // bytes are mapped, so views of a mode the game never sets cost space and nothing else.
+    [[nodiscard]] auto views_at(std::uint16_t addr, std::optional<view> from = std::nullopt) const {
+        auto result = std::vector<view>{};
+
+        if (addr < 0x8000)
+            return result;
+
+        auto base = static_cast<std::uint16_t>(addr < 0xC000 ? 0x8000 : 0xC000);
+        if (from and from->base == base)
+            result.push_back(*from);
+        else if (mapper_ == 0)
+            result.push_back({base == 0x8000 ? 0 : banks() - 1, base});
+        else
+            for (auto bank = 0; bank < banks(); ++bank)
+                result.push_back({bank, base});
+
+        return result;
+    }
+
+private:
+    int mapper_{0};
+    std::shared_ptr<const nes::rom_image> image_;
+};
+
+struct instruction {
+    std::uint16_t address;
+    std::uint8_t opcode;
+    std::uint8_t lo;
+    std::uint8_t hi;
+};
+
+struct block {
+    view v;
+    std::uint16_t address;
+    std::vector<instruction> instructions;
+    std::vector<std::uint8_t> code;
+};
+
+// Decodes straight-line code from address up to a jump, within one 1 KB page so the emulator
+// can check the block against what's mapped, and queues the places control may go next
+auto decode(const rom& r, view v, std::uint16_t address, std::vector<std::pair<view, std::uint16_t>>& next) {
+    auto b = block{v, address, {}, {}};
+    const auto page_end = (address / 1_Kb + 1) * 1_Kb;
+
+    auto follow = [&](std::uint32_t target) {
+        if (target <= 0xFFFF)
+            for (auto to: r.views_at(static_cast<std::uint16_t>(target), v))
+                next.emplace_back(to, static_cast<std::uint16_t>(target));
+    };
+
+    for (std::uint32_t pc = address;;) {
+        const auto opcode = r.read(v, static_cast<std::uint16_t>(pc));
+        const auto& op = nes::OPCODES[opcode];
+        if (not op.is_supported())
+            break;
+
+        const auto length = 1 + nes::operand_size(op.mode);
+
+        if (pc + length > page_end) {
+            follow(pc);
+            break;
+        }
+
+        auto i = instruction{static_cast<std::uint16_t>(pc), opcode, 0, 0};
+        if (length > 1)
+            i.lo = r.read(v, static_cast<std::uint16_t>(pc + 1));
+        if (length > 2)
+            i.hi = r.read(v, static_cast<std::uint16_t>(pc + 2));
+
+        b.instructions.push_back(i);
+        for (auto k = 0; k < length; ++k)
+            b.code.push_back(r.read(v, static_cast<std::uint16_t>(pc + k)));
+
+        pc += length;
+        const auto word = static_cast<std::uint16_t>(i.hi << 8 | i.lo);
+
+        if (op.mode == mode::rel) {// the block goes on where the branch isn't taken
+            follow(pc + static_cast<std::int8_t>(i.lo));
+            if (pc == page_end) {
+                follow(pc);
+                break;
+            }
+            continue;
+        }
+
+        if (nes::is_jump(op.operation)) {
+            if (op.operation == nes::mnemonic::jmp and op.mode == mode::abs)
+                follow(word);
+            if (op.operation == nes::mnemonic::jsr) {
+                follow(word);
+                follow(pc);
+            }
+            break;
+        }
+
+        // a write may switch banks under the rest of the block
+        auto may_hit_rom = (op.mode == mode::abs and word >= 0x8000)
+                           or ((op.mode == mode::abx or op.mode == mode::aby) and word + 0xFF >= 0x8000)
+                           or op.mode == mode::izx or op.mode == mode::izy;
+
+        if ((nes::writes_memory(op) and may_hit_rom) or pc == page_end) {
+            follow(pc);
+            break;
+        }
+    }
+
+    return b;
+}
+
+auto address_mode(const instruction& i, mode m) -> std::string {
+    const auto word = i.hi << 8 | i.lo;
+
+    switch (m) {
+        case mode::imp:
+            return "nes::imp";
+        case mode::acc:
+            return "nes::acc";
+        case mode::imm:
+            return "immediate(" + hex(i.address + 1, 4) + ", " + hex(i.lo, 2) + ")";
+        case mode::zp:
+            return "address(" + hex(i.lo, 2) + ")";
+        case mode::abs:
+            return "address(" + hex(word, 4) + ")";
+        case mode::zpx:
+            return "zero_page_x(" + hex(i.lo, 2) + ")";
+        case mode::zpy:
+            return "zero_page_y(" + hex(i.lo, 2) + ")";
+        case mode::abx:
+            return "absolute_x(" + hex(word, 4) + ")";
+        case mode::aby:
+            return "absolute_y(" + hex(word, 4) + ")";
+        case mode::ind:
+            return "indirect(" + hex(word, 4) + ")";
+        case mode::izx:
+            return "indirect_x(" + hex(i.lo, 2) + ")";
+        case mode::izy:
+            return "indirect_y(" + hex(i.lo, 2) + ")";
+        case mode::rel:
+            return "relative(" + hex(i.address + 2, 4) + ", " + std::to_string(static_cast<std::int8_t>(i.lo)) + ")";
+    }
+    return {};
+}
+
+auto name(const block& b) {
+    return std::to_string(b.v.bank) + "_" + hex(b.address, 4).substr(2);
+}
+
+void emit(std::ostream& out, const std::string& ns, const std::string& source, const std::vector<block>& blocks) {
+    out << "// Generated by recompile from " << source << ", do not edit\n"
+        << "#pragma once\n\n"
+        << "#include <libnes/cpu.hpp>\n\n"
+        << "#include <array>\n"
+        << "#include <cstdint>\n\n"
+        << "namespace " << ns << "\n{\n\n"
+        << "using namespace nes::fixed;\n";
+
+    for (const auto& b: blocks) {
+        out << "\ninline constexpr std::uint8_t code_" << name(b) << "[] = {";
+        for (auto k = 0u; k < b.code.size(); ++k)
+            out << (k == 0 ? "" : ", ") << hex(b.code[k], 2);
+        out << "};\n\n";
+
+        out << "template <class cpu_t>\n"
+            << "void block_" << name(b) << "(cpu_t& cpu, [[maybe_unused]] std::int64_t deadline) {\n";
+
+        for (auto k = 0u; k < b.instructions.size(); ++k) {
+            const auto& i = b.instructions[k];
+            const auto& op = nes::OPCODES[i.opcode];
+
+            if (k != 0) {
+                const auto& previous = b.instructions[k - 1];
+                if (nes::OPCODES[previous.opcode].mode == mode::rel)
+                    out << "    if (cpu.pc.value() != " << hex(i.address, 4) << " or cpu.cycles() >= deadline or cpu.is_interrupt_due())\n        return;\n";
+                else
+                    out << "    if (cpu.cycles() >= deadline or cpu.is_interrupt_due())\n        return;\n";
+            }
+
+            out << "    cpu.pc.assign(" << hex(i.address + 1 + nes::operand_size(op.mode), 4) << ");\n"
+                << "    cpu.execute(nes::" << nes::name(op.operation) << ", " << address_mode(i, op.mode) << ", " << static_cast<int>(op.cycles) << ");\n";
+        }
+        out << "}\n";
+    }
+
+    out << "\ntemplate <class cpu_t>\n"
+        << "inline const auto blocks = std::array{\n";
+    for (const auto& b: blocks)
+        out << "    nes::compiled_block<cpu_t>{" << hex(b.address, 4) << ", code_" << name(b) << ", &block_" << name(b) << "<cpu_t>},\n";
+    out << "};\n\n"
+        << "}// namespace " << ns << "\n";
+}
+
+}// namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        if (argc < 4)
+            throw std::runtime_error("usage: recompile <rom.nes> <output.hpp> <namespace> [entry point address in hex...]");
+
+        const auto r = rom{argv[1]};
+
+        auto next = std::vector<std::pair<view, std::uint16_t>>{};
+        const auto last = view{r.banks() - 1, 0xC000};
+        auto entry_points = std::vector<std::uint16_t>{};
+        for (auto vector: {0xFFFA, 0xFFFC, 0xFFFE})
+            entry_points.push_back(static_cast<std::uint16_t>(r.read(last, vector + 1) << 8 | r.read(last, vector)));
+        for (auto i = 4; i < argc; ++i)
+            entry_points.push_back(static_cast<std::uint16_t>(std::stoul(argv[i], nullptr, 16)));
+
+        for (auto target: entry_points) {
+            for (auto v: r.views_at(target))
+                next.emplace_back(v, target);
+        }
+
+        auto seen = std::set<std::pair<view, std::uint16_t>>{};
+        auto blocks = std::vector<block>{};
+
+        while (!next.empty()) {
+            auto [v, address] = next.back();
+            next.pop_back();
+
+            if (!seen.insert({v, address}).second)
+                continue;
+
+            if (auto b = decode(r, v, address, next); !b.instructions.empty())
+                blocks.push_back(std::move(b));
+        }
+
+        std::ranges::sort(blocks, {}, [](const auto& b) { return std::pair{b.v, b.address}; });
+
+        auto out = std::ofstream{argv[2]};
+        emit(out, argv[3], argv[1], blocks);
+
+        std::cout << blocks.size() << " blocks\n";
+    }
+    catch (const std::exception& ex) {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+}